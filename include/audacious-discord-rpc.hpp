@@ -4,7 +4,7 @@
  * @version 2.2
  * @author onegen <onegen@onegen.dev>
  * @author Derzsi Dániel <daniel@tohka.us>
- * @date 2025-11-28 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @license MIT
  * @copyright Copyright (c) 2024–2025 onegen
@@ -20,23 +20,34 @@
 #include <libaudcore/drct.h>
 #include <libaudcore/hook.h>
 #include <libaudcore/i18n.h>
+#include <libaudcore/mainloop.h>
+#include <libaudcore/playlist.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/probe.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/tuple.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 #ifdef _WIN32
 #     include <windows.h>
 
 #     include <shellapi.h>
-#else
-#     include <cstdlib>
 #endif
 
+#include "hook-recorder.hpp"
+#include "stats.hpp"
+
 #if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
 #     include "covers.hpp"
 #endif
@@ -47,6 +58,20 @@
 #define PLUGIN_ID "discord-rpc"
 #define PLUGIN_URL "https://github.com/onegentig/audacious-discord-rpc"
 #define DISCORD_APP_ID "1428914566795890738"
+#define COVER_CACHE_FILE "discord-rpc-covers.tsv"  // In Audacious user dir
+
+constexpr unsigned int CONNECT_TIMEOUT = 5000;          // [ms]
+constexpr unsigned int RECONNECT_MIN_DELAY = 1000;      // [ms]
+constexpr unsigned int RECONNECT_MAX_DELAY = 60000;     // [ms]
+constexpr unsigned int STREAM_MIN_UPDATE = 15000;       // [ms]
+constexpr unsigned int STREAM_COVER_INTERVAL = 300000;  // [ms]
+
+/* Clock of the stream throttling; trace time in the replay runner */
+#ifdef RPC_CLOCK
+using rpc_clock = RPC_CLOCK;
+#else
+using rpc_clock = std::chrono::steady_clock;
+#endif
 
 static std::atomic<bool> is_connected{false};
 static std::atomic<unsigned long long> req_id_now{0};
@@ -56,18 +81,24 @@ inline bool cover_fetch_stop(unsigned long long req_id) {
 
 /* === Discord Functions === */
 
-void init_discord();
+void init_discord();  // Starts the background connector
 void clear_discord();
 void cleanup_discord();
+void send_presence();  // Expects presence_mtx to be held
 void update_presence();
 void init_presence();
 
-void playback_to_presence();  // Audacious metadata -> Discord RPC (main)
-void cover_to_presence(
-    const String &artist,
-    const String &album);  // Attempts to fetch cover, if enabled
+void playback_to_presence(
+    const char *hook);  // Audacious metadata -> Discord RPC (main)
+void cover_to_presence(const String &artist, const String &album,
+                       const String &filename, bool is_stream,
+                       unsigned long long req_id);  // Fetches cover, if on
 
-void on_playback_update_rpc(void *, void *) { playback_to_presence(); }
+void on_playback_update_rpc(void *, void *hook) {
+     RPCStats::bump(stats.hooks);
+     recorder.record(static_cast<const char *>(hook));
+     playback_to_presence(static_cast<const char *>(hook));
+}
 
 /* === Utilities === */
 
@@ -0,0 +1,193 @@
+/**
+ * @file coverd.hpp
+ * @brief Client of the shared cover cache daemon (discord-rpc-coverd).
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note The daemon owns one persistent cover cache for all players on the
+ *       host and talks over a Unix domain socket. Protocol: the client
+ *       sends `<artist>` US `<album>` LF (US = 0x1F), the daemon answers
+ *       `<URL>` LF, or just LF if no cover was found. Several requests may
+ *       be sent over one connection. Unix-only; elsewhere, and whenever the
+ *       daemon is not running, lookups fall back to the in-process path.
+ *
+ *       The socket is the user's own ($XDG_RUNTIME_DIR) or a system-wide
+ *       one in /run. Clients only talk to a daemon run by themselves, root
+ *       or the user in $AUD_DISCORD_RPC_COVERD_UID (checked on the socket
+ *       file and on the peer), and only take https:// URLs from it.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#     include <poll.h>
+#     include <sys/socket.h>
+#     include <sys/stat.h>
+#     include <sys/un.h>
+#     include <unistd.h>
+#endif
+
+#define COVERD_SOCKET_ENV "AUD_DISCORD_RPC_COVERD"
+#define COVERD_UID_ENV "AUD_DISCORD_RPC_COVERD_UID"
+#define COVERD_SOCKET_NAME "audacious-discord-rpc-coverd.sock"  // User's own
+#define COVERD_SOCKET_SYSTEM "/run/audacious-discord-rpc/coverd.sock"
+
+constexpr unsigned int COVERD_TIMEOUT = 60000;  // [ms]
+constexpr std::size_t COVERD_MAX_REPLY = 2048;  // [B], URL + LF
+
+enum class CoverdReply {
+     Unavailable,  //< No daemon (or it broke down), look up in-process
+     Miss,         //< Daemon found no cover (or lookup was cancelled)
+     Hit
+};
+
+/** @brief Sockets to try in order: $AUD_DISCORD_RPC_COVERD alone, if set */
+inline std::vector<std::string> coverd_socket_paths() {
+     const char* path = getenv(COVERD_SOCKET_ENV);
+     if (path && *path) return {path};
+     std::vector<std::string> paths;
+     const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+     if (runtime_dir && *runtime_dir)
+          paths.push_back(std::string(runtime_dir) + "/" COVERD_SOCKET_NAME);
+     paths.push_back(COVERD_SOCKET_SYSTEM);
+     return paths;
+}
+
+/** @brief Only https:// URLs, without whitespace or control characters */
+inline bool coverd_url_ok(const std::string& url) {
+     if (!url.starts_with("https://") || url.size() >= COVERD_MAX_REPLY)
+          return false;
+     for (unsigned char c : url)
+          if (c <= ' ' || c == 0x7F) return false;
+     return true;
+}
+
+#ifndef _WIN32
+/** @brief Own uid, root, or the daemon user in $AUD_DISCORD_RPC_COVERD_UID */
+inline bool coverd_uid_trusted(uid_t uid) {
+     if (uid == getuid() || uid == 0) return true;
+     const char* daemon_uid = getenv(COVERD_UID_ENV);
+     char* end = nullptr;
+     if (!daemon_uid || !*daemon_uid) return false;
+     unsigned long trusted = strtoul(daemon_uid, &end, 10);
+     return !*end && uid == static_cast<uid_t>(trusted);
+}
+
+/** @brief User at the other end of a connected Unix socket */
+inline bool coverd_peer_uid(int fd, uid_t& uid) {
+#     ifdef SO_PEERCRED
+     ucred cred{};
+     socklen_t len = sizeof(cred);
+     if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+          return false;
+     uid = cred.uid;
+     return true;
+#     else
+     gid_t gid;
+     return getpeereid(fd, &uid, &gid) == 0;
+#     endif
+}
+
+/** @brief Connects to the first trusted daemon socket; -1 if none */
+inline int coverd_connect() {
+     for (const std::string& path : coverd_socket_paths()) {
+          sockaddr_un addr{};
+          addr.sun_family = AF_UNIX;
+          if (path.size() >= sizeof(addr.sun_path)) continue;
+          strcpy(addr.sun_path, path.c_str());
+
+          // Anyone could have put a socket there (e.g. a shared /tmp)
+          struct stat st;
+          if (lstat(path.c_str(), &st) < 0 || !S_ISSOCK(st.st_mode)
+              || !coverd_uid_trusted(st.st_uid))
+               continue;
+
+          int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+          if (fd < 0) return -1;
+          uid_t peer;
+          if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+                  == 0
+              && coverd_peer_uid(fd, peer) && coverd_uid_trusted(peer))
+               return fd;
+          close(fd);
+     }
+     return -1;
+}
+#endif
+
+/** @brief Asks the daemon for a cover; `url` is set on a hit */
+inline CoverdReply coverd_lookup(
+    const std::string& artist, const std::string& album, std::string& url,
+    const std::atomic<unsigned long long>* active_req_id = nullptr,
+    unsigned long long this_req_id = 0) {
+#ifdef _WIN32
+     (void)artist, (void)album, (void)url, (void)active_req_id,
+         (void)this_req_id;
+     return CoverdReply::Unavailable;
+#else
+     if (artist.find_first_of("\x1F\n") != std::string::npos
+         || album.find_first_of("\x1F\n") != std::string::npos)
+          return CoverdReply::Unavailable;  // Not expressible in protocol
+
+     int fd = coverd_connect();
+     if (fd < 0) return CoverdReply::Unavailable;
+
+     std::string req = artist + '\x1F' + album + '\n';
+     for (std::size_t sent = 0; sent < req.size();) {
+          ssize_t n = send(fd, req.data() + sent, req.size() - sent,
+                           MSG_NOSIGNAL);
+          if (n <= 0) {
+               close(fd);
+               return CoverdReply::Unavailable;
+          }
+          sent += n;
+     }
+
+     // Wait for the reply line, in steps so a superseded lookup can leave
+     std::string reply;
+     const auto deadline = std::chrono::steady_clock::now()
+                           + std::chrono::milliseconds(COVERD_TIMEOUT);
+     while (reply.empty() || reply.back() != '\n') {
+          if (active_req_id && this_req_id != active_req_id->load()) {
+               close(fd);
+               return CoverdReply::Miss;  // Nobody wants the answer anymore
+          }
+          if (std::chrono::steady_clock::now() > deadline) {
+               close(fd);
+               return CoverdReply::Unavailable;
+          }
+
+          pollfd pfd{fd, POLLIN, 0};
+          if (poll(&pfd, 1, 100) <= 0) continue;
+          char buf[512];
+          ssize_t n = recv(fd, buf, sizeof(buf), 0);
+          if (n <= 0) {
+               close(fd);
+               return CoverdReply::Unavailable;
+          }
+          reply.append(buf, n);
+          if (reply.size() > COVERD_MAX_REPLY) {
+               close(fd);
+               return CoverdReply::Unavailable;
+          }
+     }
+     close(fd);
+
+     reply.pop_back();
+     if (reply.empty()) return CoverdReply::Miss;
+     if (!coverd_url_ok(reply)) return CoverdReply::Unavailable;
+     url = std::move(reply);
+     return CoverdReply::Hit;
+#endif
+}
@@ -2,23 +2,39 @@
  * @file cover-cache.hpp
  * @brief Cache for album cover arts for Audacious Discord RPC (experimental)
  * @author onegen <onegen@onegen.dev>
- * @date 2025-11-27 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @note Custom solution for minimalism and not having to tackle with deps.
- *       Uses LRU eviction policy + no admission policy.
+ *       Uses LRU eviction policy + no admission policy. Thread-safe: keys
+ *       are spread over shards, each with its own reader-writer lock.
+ *       Expired entries are kept (stale) for a while, so they can still
+ *       be served while being revalidated upstream, instead of looked up
+ *       from scratch.
  *
  * @license MIT
- * @copyright Copyright (c) 2025 onegen
+ * @copyright Copyright (c) 2025–2026 onegen
  *
  */
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <list>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <variant>
 
 #ifndef AUDDBG
 #     define AUDDBG(...) ((void)0)
@@ -32,6 +48,135 @@
 
 constexpr std::size_t TIMESTAMP_SIZE
     = sizeof(std::chrono::steady_clock::time_point);
+constexpr std::size_t CACHE_SHARDS = 16;
+
+/** @brief HTTP validators of the reply a cover was resolved from */
+struct CoverValidators {
+     std::string etag;           //< Sent as If-None-Match
+     std::string last_modified;  //< Sent as If-Modified-Since
+
+     bool empty() const { return etag.empty() && last_modified.empty(); }
+     std::size_t size() const { return etag.size() + last_modified.size(); }
+};
+
+/**
+ * @brief Cached image URL in compact form where possible.
+ *
+ * CAA thumbnail URLs (`http[s]://coverartarchive.org/release/<MBID>/<image
+ * id>-<size>.jpg`) make up nearly all values, yet most of their ~90 bytes is
+ * a repeated prefix and a hex-encoded UUID. Those are stored as a binary MBID
+ * + numbers and rebuilt on a hit. Anything else is kept as a raw string.
+ */
+class CoverValue {
+   public:
+     CoverValue(const std::string& url) : val(encode(url)) {}
+
+     std::string str() const {
+          if (auto* raw = std::get_if<std::string>(&val)) return *raw;
+          return decode(std::get<CaaUrl>(val));
+     }
+
+     /** @brief Bytes accounted for the value in the cache budget */
+     std::size_t size() const {
+          if (auto* raw = std::get_if<std::string>(&val)) return raw->size();
+          return sizeof(CaaUrl);
+     }
+
+     /** @brief Release MBID the URL belongs to, if it is a CAA one */
+     std::optional<std::string> release() const {
+          auto* caa = std::get_if<CaaUrl>(&val);
+          if (!caa) return std::nullopt;
+          std::string mbid;
+          mbid.reserve(36);
+          append_mbid(mbid, caa->mbid);
+          return mbid;
+     }
+
+   private:
+     struct CaaUrl {
+          std::array<std::uint8_t, 16> mbid;  //< Release MBID (UUID bytes)
+          std::uint64_t image_id;             //< CAA image ID
+          std::uint16_t thumb;                //< Thumbnail size (e.g. 500)
+          bool https;
+     };
+
+     static constexpr char CAA_HOST[] = "coverartarchive.org/release/";
+     static constexpr char HEX[] = "0123456789abcdef";
+
+     static std::variant<CaaUrl, std::string> encode(const std::string& url) {
+          CaaUrl c{};
+          std::size_t pos = 0;
+          if (url.starts_with("https://")) {
+               c.https = true;
+               pos = 8;
+          } else if (url.starts_with("http://")) {
+               pos = 7;
+          } else {
+               return url;
+          }
+
+          if (url.compare(pos, sizeof(CAA_HOST) - 1, CAA_HOST) != 0) return url;
+          pos += sizeof(CAA_HOST) - 1;
+
+          // MBID: 8-4-4-4-12 hex digits
+          std::size_t n_byte = 0;
+          for (std::size_t i = 0; i < 36; ++i) {
+               if (pos + i >= url.size()) return url;
+               char ch = url[pos + i];
+               if (i == 8 || i == 13 || i == 18 || i == 23) {
+                    if (ch != '-') return url;
+                    continue;
+               }
+               std::uint8_t nib;
+               auto [_, ec] = std::from_chars(&ch, &ch + 1, nib, 16);
+               if (ec != std::errc()) return url;
+               c.mbid[n_byte / 2] = (n_byte % 2) ? (c.mbid[n_byte / 2] | nib)
+                                                 : (nib << 4);
+               ++n_byte;
+          }
+          pos += 36;
+
+          const char* end = url.data() + url.size();
+          if (pos >= url.size() || url[pos] != '/') return url;
+          auto [id_end, id_ec]
+              = std::from_chars(url.data() + pos + 1, end, c.image_id);
+          if (id_ec != std::errc() || id_end == end || *id_end != '-')
+               return url;
+          auto [th_end, th_ec] = std::from_chars(id_end + 1, end, c.thumb);
+          if (th_ec != std::errc() || std::string(th_end, end) != ".jpg")
+               return url;
+
+          // Only keep it compact if it rebuilds to the exact same string
+          // (rules out upper-case hex, leading zeros etc.)
+          if (decode(c) != url) return url;
+          return c;
+     }
+
+     static std::string decode(const CaaUrl& c) {
+          std::string url;
+          url.reserve(96);
+          url.append(c.https ? "https://" : "http://");
+          url.append(CAA_HOST);
+          append_mbid(url, c.mbid);
+          url.push_back('/');
+          url.append(std::to_string(c.image_id));
+          url.push_back('-');
+          url.append(std::to_string(c.thumb));
+          url.append(".jpg");
+          return url;
+     }
+
+     static void append_mbid(std::string& s,
+                             const std::array<std::uint8_t, 16>& mbid) {
+          for (std::size_t i = 0; i < mbid.size(); ++i) {
+               if (i == 4 || i == 6 || i == 8 || i == 10) s.push_back('-');
+               s.push_back(HEX[mbid[i] >> 4]);
+               s.push_back(HEX[mbid[i] & 0xF]);
+          }
+     }
+
+     std::variant<CaaUrl, std::string> val;
+};
 
 class CoverArtCache {
    public:
@@ -43,11 +188,23 @@ class CoverArtCache {
               = 4 * 1024 * 1024;  // Capacity of n bytes (0 = unlimited)
           std::chrono::seconds ttl{
               0};  // Entry TTL in seconds (0 = keep forever)
+          std::chrono::seconds stale{
+              0};  // Expired entries kept for revalidation (0 = not kept)
      };
 
+     /** @brief Stale (expired but kept) entry, see get_stale() */
+     struct StaleEntry {
+          std::string url;
+          std::optional<std::string> release;  //< MBID, if a CAA URL
+          CoverValidators validators;
+     };
+
+     /* Capacity is split evenly among the shards */
      CoverArtCache(std::size_t max_items, std::size_t max_bytes,
-                   std::chrono::seconds ttl)
-         : opts{max_items, max_bytes, ttl} {}
+                   std::chrono::seconds ttl,
+                   std::chrono::seconds stale = std::chrono::seconds(0))
+         : opts{(max_items + CACHE_SHARDS - 1) / CACHE_SHARDS,
+                (max_bytes + CACHE_SHARDS - 1) / CACHE_SHARDS, ttl, stale} {}
 
      static std::string key(const std::string& artist,
                             const std::string& album) {
@@ -59,108 +216,341 @@ class CoverArtCache {
           return k;
      }
 
+     /** @param validators Set to the entry's on a hit, if given */
      std::optional<std::string> get(const std::string& artist,
-                                    const std::string& album) {
+                                    const std::string& album,
+                                    CoverValidators* validators = nullptr) {
           std::string k = key(artist, album);
-          auto map_it = cachemap.find(k);
-          if (map_it == cachemap.end()) return std::nullopt;
+          Shard& shard = shard_of(k);
+          {
+               // Hits only take a shared lock and bump an atomic
+               std::shared_lock<std::shared_mutex> lock(shard.mtx);
+               auto map_it = shard.cachemap.find(k);
+               if (map_it == shard.cachemap.end()) return std::nullopt;
+               if (!is_expired(map_it->second)) {
+                    map_it->second.last_use.store(
+                        clk::now().time_since_epoch().count(),
+                        std::memory_order_relaxed);
+                    if (validators) *validators = map_it->second.validators;
+                    return map_it->second.val.str();
+               }
+          }
 
-          if (opts.ttl.count()
-              && (clk::now() - map_it->second.timestamp) > opts.ttl) {
-               drop(k, map_it);
+          // Expired => keep for revalidation, or drop if too old for that
+          // (unless it got refreshed in the meantime)
+          std::unique_lock<std::shared_mutex> lock(shard.mtx);
+          auto map_it = shard.cachemap.find(k);
+          if (map_it != shard.cachemap.end() && is_dead(map_it->second))
+               drop(shard, map_it);
+          return std::nullopt;
+     }
+
+     /** @brief Gets an entry even if expired, as long as it is still kept */
+     std::optional<StaleEntry> get_stale(const std::string& artist,
+                                         const std::string& album) {
+          std::string k = key(artist, album);
+          Shard& shard = shard_of(k);
+          std::shared_lock<std::shared_mutex> lock(shard.mtx);
+          auto map_it = shard.cachemap.find(k);
+          if (map_it == shard.cachemap.end() || is_dead(map_it->second))
                return std::nullopt;
+          const CacheEntry& entry = map_it->second;
+          return StaleEntry{entry.val.str(), entry.val.release(),
+                            entry.validators};
+     }
+
+     /** @param validators Of the reply the URL was resolved from, if any */
+     void put(const std::string& artist, const std::string& album,
+              const std::string& val,
+              const CoverValidators& validators = CoverValidators()) {
+          put_key(key(artist, album), val, validators, clk::now());
+     }
+
+     void clear() {
+          for (Shard& shard : shards) {
+               std::unique_lock<std::shared_mutex> lock(shard.mtx);
+               shard.cachemap.clear();
+               shard.bytes_used = 0;
           }
+     }
+
+     /**
+      * @brief Writes all entries to a file, replacing it atomically.
+      * @note One entry per line: `<UNIX time of insertion or update>` TAB
+      *       `<artist>` TAB `<album>` TAB `<URL>`, followed by TAB `<ETag>`
+      *       TAB `<Last-Modified>` if the entry has validators. Entries with
+      *       tabs or newlines in them are skipped.
+      * @param merge Keep entries of the file that are newer than ours, or
+      *              that we do not have (e.g. written by the warmer while
+      *              the plugin ran), unless too old to be kept. Entries
+      *              another process saves between our read and our rename
+      *              are still lost.
+      */
+     bool save(const std::string& path, bool merge = false) {
+          const auto steady_now = clk::now();
+          const auto system_now = std::chrono::system_clock::now();
 
-          auto list_it = std::find(uselist.begin(), uselist.end(), k);
-          if (list_it != uselist.end()) {
-               uselist.erase(list_it);
-               uselist.push_front(k);
+          // Ours first (by key), so the file can be merged line by line
+          std::unordered_map<std::string, std::pair<long long, std::string>>
+              lines;
+          for (Shard& shard : shards) {
+               std::shared_lock<std::shared_mutex> lock(shard.mtx);
+               for (auto& [k, entry] : shard.cachemap) {
+                    std::string url = entry.val.str();
+                    const CoverValidators& v = entry.validators;
+                    if (has_tab_or_nl(k) || has_tab_or_nl(url)
+                        || has_tab_or_nl(v.etag)
+                        || has_tab_or_nl(v.last_modified))
+                         continue;
+
+                    auto inserted = std::chrono::system_clock::to_time_t(
+                        std::chrono::time_point_cast<
+                            std::chrono::system_clock::duration>(
+                            system_now - (steady_now - entry.timestamp)));
+                    std::string line = k;
+                    line[line.find('\x1F')] = '\t';
+                    line += '\t' + url;
+                    if (!v.empty())
+                         line += '\t' + v.etag + '\t' + v.last_modified;
+                    lines.try_emplace(k, static_cast<long long>(inserted),
+                                      std::move(line));
+               }
           }
 
-          return map_it->second.val;
+          // Unique, as the plugin, warmer and daemon may save at once
+          const std::string tmp_path
+              = path + ".tmp"
+                + std::to_string(
+                    steady_now.time_since_epoch().count()
+                    ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+          {
+               std::ofstream out(tmp_path, std::ios::trunc);
+               if (!out) return false;
+
+               std::ifstream in;
+               if (merge) in.open(path);
+               std::string line;
+               while (in && std::getline(in, line)) {
+                    std::string k;
+                    long long inserted;
+                    if (!parse_head(line, k, inserted)
+                        || is_dead_at(inserted, system_now))
+                         continue;
+                    auto ours = lines.find(k);
+                    if (ours != lines.end()) {
+                         if (ours->second.first >= inserted) continue;
+                         lines.erase(ours);  // Theirs is newer
+                    }
+                    out << line << '\n';
+               }
+
+               for (auto& [_, entry] : lines)
+                    out << entry.first << '\t' << entry.second << '\n';
+               if (!out.flush()) {
+                    out.close();
+                    std::remove(tmp_path.c_str());
+                    return false;
+               }
+          }
+
+          std::error_code ec;
+          std::filesystem::rename(tmp_path, path, ec);
+          if (ec) std::remove(tmp_path.c_str());
+          return !ec;
      }
 
-     void put(const std::string& artist, const std::string& album,
-              const std::string& val) {
-          std::string k = key(artist, album);
-          if ((2 * k.size()) + val.size() + TIMESTAMP_SIZE > opts.max_bytes) {
+     /**
+      * @brief Loads entries written by save(), skipping ones not kept
+      * @param fresh_keys If set, gets the key of every unexpired entry read,
+      *                   including ones the cache has no room for
+      */
+     std::size_t load(const std::string& path,
+                      std::set<std::string>* fresh_keys = nullptr) {
+          std::ifstream in(path);
+          if (!in) return 0;
+
+          const auto steady_now = clk::now();
+          const auto system_now = std::chrono::system_clock::now();
+          std::size_t n_loaded = 0;
+          std::string line;
+          while (std::getline(in, line)) {
+               auto t1 = line.find('\t');
+               auto t2 = line.find('\t', t1 + 1);
+               auto t3 = line.find('\t', t2 + 1);
+               if (t1 == std::string::npos || t2 == std::string::npos
+                   || t3 == std::string::npos)
+                    continue;
+
+               long long inserted = 0;
+               auto [_, ec]
+                   = std::from_chars(line.data(), line.data() + t1, inserted);
+               if (ec != std::errc() || is_dead_at(inserted, system_now))
+                    continue;
+               auto age = system_now
+                          - std::chrono::system_clock::from_time_t(inserted);
+               if (age < clk::duration::zero()) age = clk::duration::zero();
+
+               // Validators are optional (and missing in older files)
+               auto t4 = line.find('\t', t3 + 1);
+               auto t5 = line.find('\t', t4 + 1);
+               CoverValidators validators;
+               if (t4 != std::string::npos && t5 != std::string::npos) {
+                    validators.etag = line.substr(t4 + 1, t5 - t4 - 1);
+                    validators.last_modified = line.substr(t5 + 1);
+               }
+
+               std::string k = key(line.substr(t1 + 1, t2 - t1 - 1),
+                                   line.substr(t2 + 1, t3 - t2 - 1));
+               if (fresh_keys && (!opts.ttl.count() || age <= opts.ttl))
+                    fresh_keys->insert(k);
+               put_key(k, line.substr(t3 + 1, t4 - t3 - 1), validators,
+                       steady_now
+                           - std::chrono::duration_cast<clk::duration>(age));
+               ++n_loaded;
+          }
+          return n_loaded;
+     }
+
+   private:
+     void put_key(const std::string& k, const std::string& val,
+                  CoverValidators validators, clk::time_point timestamp) {
+          // If-None-Match takes precedence over If-Modified-Since anyway
+          // (RFC 9110), so the date is only kept if there is no ETag
+          if (!validators.etag.empty()) validators.last_modified.clear();
+
+          CoverValue cval(val);
+          if (k.size() + cval.size() + validators.size() + TIMESTAMP_SIZE
+              > opts.max_bytes) {
                AUDDBG(
                    "Discord RPC: put() of an entry bigger than cache size "
                    "attempted!\r\n");
                return;
           }
 
-          auto map_it = cachemap.find(k);
-          if (map_it != cachemap.end()) {
-               // Key exists => update val & timestamp + move to front
-               bytes_used -= map_it->second.val.size();  // - old val size
-               map_it->second.val = val;
-               map_it->second.timestamp = clk::now();
-               bytes_used += val.size();  // + new val size
-
-               auto list_it = std::find(uselist.begin(), uselist.end(), k);
-               if (list_it != uselist.end()) uselist.erase(list_it);
-
-               uselist.push_front(k);
+          Shard& shard = shard_of(k);
+          std::unique_lock<std::shared_mutex> lock(shard.mtx);
+          auto map_it = shard.cachemap.find(k);
+          if (map_it != shard.cachemap.end()) {
+               // Key exists => update val, timestamp & recency
+               shard.bytes_used -= map_it->second.val.size()
+                                   + map_it->second.validators.size();  // - old
+               map_it->second.val = cval;
+               map_it->second.validators = std::move(validators);
+               map_it->second.timestamp = timestamp;
+               map_it->second.last_use.store(
+                   clk::now().time_since_epoch().count(),
+                   std::memory_order_relaxed);
+               shard.bytes_used += cval.size()
+                                   + map_it->second.validators.size();  // + new
           } else {
                // New key => insert
-               cachemap.emplace(k, CacheEntry{val, clk::now()});
-               uselist.push_front(k);
-               bytes_used
+               shard.bytes_used
                    += k.size() + TIMESTAMP_SIZE;  // + key & timestamp sizes
-               bytes_used += val.size();          // + new val size
+               shard.bytes_used += cval.size() + validators.size();  // + new
+               shard.cachemap.try_emplace(k, cval, std::move(validators),
+                                          timestamp);
           }
 
-          enforce();
+          enforce(shard);
      }
 
-     void clear() {
-          cachemap.clear();
-          uselist.clear();
-          bytes_used = 0;
-     }
-
-   private:
      struct CacheEntry {
-          std::string val;  //< Value (image URL)
+          CacheEntry(const CoverValue& val, CoverValidators validators,
+                     clk::time_point timestamp)
+              : val(val),
+                validators(std::move(validators)),
+                timestamp(timestamp),
+                last_use(timestamp.time_since_epoch().count()) {}
+
+          CoverValue val;              //< Value (image URL)
+          CoverValidators validators;  //< For revalidation once expired
           clk::time_point
               timestamp;  //< Timestamp of insertion or update (for TTL)
+          std::atomic<clk::rep> last_use;  //< Last hit (for LRU), lock-free
      };
 
-     void drop(const std::string& k,
-               std::unordered_map<std::string, CacheEntry>::iterator it) {
-          bytes_used -= it->second.val.size() + k.size() + TIMESTAMP_SIZE;
-          uselist.remove(k);
-          cachemap.erase(it);
+     using CacheMap = std::unordered_map<std::string, CacheEntry>;
+
+     /* Recency is an atomic timestamp instead of a use list, so hits can
+      * update it under a shared lock. Eviction scans the shard for the
+      * oldest entry, which is cheap at the shard sizes used. */
+     struct alignas(64) Shard {
+          std::shared_mutex mtx;
+          CacheMap cachemap;
+          std::size_t bytes_used = 0;  //< Size of shard in bytes.
+     };
+
+     Shard& shard_of(const std::string& k) {
+          return shards[std::hash<std::string>{}(k) % CACHE_SHARDS];
      }
 
-     bool is_overflowing() const {
-          if (uselist.empty()) return false;
-          if ((opts.max_items != 0) && (uselist.size() > opts.max_items))
+     bool is_expired(const CacheEntry& entry) const {
+          return opts.ttl.count() && (clk::now() - entry.timestamp) > opts.ttl;
+     }
+
+     /** @brief Expired and no longer kept for revalidation either */
+     bool is_dead(const CacheEntry& entry) const {
+          return opts.ttl.count()
+                 && (clk::now() - entry.timestamp) > opts.ttl + opts.stale;
+     }
+
+     /** @brief Too old to be kept, by a UNIX time as in save() */
+     bool is_dead_at(long long inserted,
+                     std::chrono::system_clock::time_point now) const {
+          return opts.ttl.count()
+                 && now - std::chrono::system_clock::from_time_t(inserted)
+                        > opts.ttl + opts.stale;
+     }
+
+     /** @brief Key and time of insertion of a line written by save() */
+     static bool parse_head(const std::string& line, std::string& k,
+                            long long& inserted) {
+          auto t1 = line.find('\t');
+          auto t2 = line.find('\t', t1 + 1);
+          auto t3 = line.find('\t', t2 + 1);
+          if (t1 == std::string::npos || t2 == std::string::npos
+              || t3 == std::string::npos)
+               return false;
+          auto [_, ec]
+              = std::from_chars(line.data(), line.data() + t1, inserted);
+          if (ec != std::errc()) return false;
+          k = key(line.substr(t1 + 1, t2 - t1 - 1),
+                  line.substr(t2 + 1, t3 - t2 - 1));
+          return true;
+     }
+
+     static bool has_tab_or_nl(const std::string& s) {
+          return s.find_first_of("\t\n") != std::string::npos;
+     }
+
+     static void drop(Shard& shard, CacheMap::iterator it) {
+          shard.bytes_used -= it->second.val.size()
+                              + it->second.validators.size() + it->first.size()
+                              + TIMESTAMP_SIZE;
+          shard.cachemap.erase(it);
+     }
+
+     bool is_overflowing(const Shard& shard) const {
+          if (shard.cachemap.empty()) return false;
+          if ((opts.max_items != 0) && (shard.cachemap.size() > opts.max_items))
                return true;
-          if ((opts.max_bytes != 0) && (bytes_used > opts.max_bytes))
+          if ((opts.max_bytes != 0) && (shard.bytes_used > opts.max_bytes))
                return true;
           return false;
      }
 
-     void enforce() {
-          if (cachemap.size() != uselist.size())
-               AUDINFO(
-                   "Discord RPC: Cache sanity check failed! Cachemap size "
-                   "(%zu) is not equal to uselist size (%zu)!\r\n",
-                   cachemap.size(),
-                   uselist.size());  // Just a sanity check, should NEVER happen
-
-          while (this->is_overflowing()) {
-               // Evict the least frequently used item (LRU)
-               const std::string& k_lru = uselist.back();
-               auto it = cachemap.find(k_lru);
-               if (it != cachemap.end()) drop(k_lru, it);
+     void enforce(Shard& shard) {
+          while (is_overflowing(shard)) {
+               // Evict the least recently used item (LRU)
+               auto lru = shard.cachemap.begin();
+               for (auto it = lru; it != shard.cachemap.end(); ++it)
+                    if (it->second.last_use.load(std::memory_order_relaxed)
+                        < lru->second.last_use.load(std::memory_order_relaxed))
+                         lru = it;
+               drop(shard, lru);
           }
      }
 
-     CacheOptions opts;  //< Cache settings, like capacity and TTL.
-     std::unordered_map<std::string, CacheEntry> cachemap;
-     std::list<std::string> uselist;  //< List of keys ordered by use recency.
-     std::size_t bytes_used = 0;      //< Size of cache in bytes.
-};
\ No newline at end of file
+     const CacheOptions opts;  //< Per-shard settings, like capacity and TTL.
+     std::array<Shard, CACHE_SHARDS> shards;
+};
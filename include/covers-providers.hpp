@@ -0,0 +1,358 @@
+/**
+ * @file covers-providers.hpp
+ * @brief Cover art providers for Audacious Discord RPC (experimental)
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Each provider resolves an (album artist, album) pair to an image URL
+ *       together with a match score. Providers are raced by cover_lookup(),
+ *       so lookup() has to be thread-safe and should give up as soon as the
+ *       passed token is cancelled.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+#ifndef JSON_NOEXCEPTION
+#     define JSON_NOEXCEPTION
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "covers-cache.hpp"
+#include "fetch-hedge.hpp"
+
+using json = nlohmann::json;
+
+constexpr unsigned int FETCH_DEBOUNCE = 2000;  // [ms]
+constexpr unsigned int FETCH_MAX_RETRIES = 5;
+
+/* === Helpers === */
+
+inline std::string esc_quotes(const std::string& s) {
+     std::string r;
+     r.reserve(s.size());
+     for (char c : s)
+          if (c == '"' || c == '\\')
+               r += '\\', r += c;
+          else
+               r += c;
+     return r;
+}
+
+/** @brief Lowercases ASCII and drops ASCII punctuation/spaces (for matching) */
+inline std::string normalise(const std::string& s) {
+     std::string r;
+     r.reserve(s.size());
+     for (unsigned char c : s)
+          if (c >= 0x80 || std::isalnum(c)) r += std::tolower(c);
+     return r;
+}
+
+/**
+ * @brief True if normalised @p s starts with @p n_prefix (normalised) and
+ *        the prefix ends a word of @p s, e.g. "Live at Wembley" for "live",
+ *        but not "Lively"
+ */
+inline bool starts_with_words(const std::string& s,
+                              const std::string& n_prefix) {
+     auto is_word
+         = [](unsigned char c) { return c >= 0x80 || std::isalnum(c); };
+     std::size_t i = 0, matched = 0;
+     for (; i < s.size() && matched < n_prefix.size(); ++i) {
+          const unsigned char c = s[i];
+          if (!is_word(c)) continue;
+          if (static_cast<char>(std::tolower(c)) != n_prefix[matched])
+               return false;
+          ++matched;
+     }
+     return matched == n_prefix.size()
+            && (i == s.size() || !is_word(static_cast<unsigned char>(s[i])));
+}
+
+inline bool is_cancelled(const std::atomic<unsigned long long>* active_req_id,
+                         unsigned long long this_req_id) {
+     return active_req_id && (this_req_id != active_req_id->load());
+}
+
+/** @brief Cancellation state of one lookup, shared with its providers */
+struct LookupToken {
+     const std::atomic<unsigned long long>* active_req_id = nullptr;
+     unsigned long long this_req_id = 0;
+     std::atomic<bool> settled{false};  //< Race decided (won or timed out)
+
+     bool cancelled() const {
+          return settled.load() || is_cancelled(active_req_id, this_req_id);
+     }
+};
+
+/** @brief Picks the front cover (large thumbnail) from a CAA release reply */
+inline std::optional<std::string> caa_front_cover(const std::string& caa_json) {
+     auto caa = json::parse(caa_json, nullptr, false);
+     if (caa.is_discarded() || !caa.is_object() || !caa.contains("images")
+         || !caa["images"].is_array())
+          return std::nullopt;
+
+     for (auto& image : caa["images"]) {
+          if (image.contains("front") && image["front"] == true
+              && image.contains("thumbnails")
+              && image["thumbnails"].contains("large")
+              && image["thumbnails"]["large"].is_string()) {
+               auto url = image["thumbnails"]["large"].get<std::string>();
+               if (url.starts_with("http://"))  // Older entries; CAA has TLS
+                    url = "https://" + url.substr(7);
+               return url;
+          }
+     }
+     return std::nullopt;
+}
+
+/** @brief Sleeps in 100 ms steps; returns false if cancelled meanwhile */
+inline bool sleep_unless_cancelled(unsigned int ms, const LookupToken& token) {
+     for (unsigned int slept = 0; slept < ms; slept += 100) {
+          if (token.cancelled()) return false;
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+     }
+     return !token.cancelled();
+}
+
+/* === Provider Interface === */
+
+struct CoverResult {
+     std::string url;             //< Image URL
+     unsigned int score;          //< Match confidence (0–100)
+     CoverValidators validators;  //< Of the reply naming the URL, if any
+};
+
+class CoverProvider {
+   public:
+     CoverProvider(unsigned int min_score, std::chrono::milliseconds timeout,
+                   bool enabled)
+         : min_score(min_score), timeout(timeout), enabled(enabled) {}
+     virtual ~CoverProvider() = default;
+
+     virtual const char* name() const = 0;
+     virtual std::optional<CoverResult> lookup(
+         const std::string& artist, const std::string& album,
+         const LookupToken& token) const = 0;
+
+     const unsigned int min_score;  //< Results scored lower are rejected
+     const std::chrono::milliseconds timeout;  //< Later results are ignored
+     std::atomic<bool> enabled;                //< Takes part in lookups
+};
+
+/* === MusicBrainz + Cover Art Archive === */
+
+class MusicBrainzProvider : public CoverProvider {
+   public:
+     MusicBrainzProvider()
+         : CoverProvider(90, std::chrono::milliseconds(45000), true) {}
+
+     const char* name() const override { return "MusicBrainz/CAA"; }
+
+     std::optional<CoverResult> lookup(
+         const std::string& artist, const std::string& album,
+         const LookupToken& token) const override {
+          auto cancelled = [&token] { return token.cancelled(); };
+
+          unsigned int tries = 0;
+          do {
+               // Back off before retrying a bad reply
+               if (tries && !sleep_unless_cancelled(FETCH_DEBOUNCE, token))
+                    return std::nullopt;
+
+               /* The query disregards the track artist, focusing on the album
+                * artist a la LastFM. Album title is prioritised over album
+                * alias. Artist name is also checked for label (for
+                * compilations, like Monstercat, which MB often tags as
+                * "Various Artists") but most users use "Monstercat". Artist
+                * match is slightly prioritised over label. All formats are
+                * accepted (for e.g. CD rips) but digital media has slight
+                * priority. Only matches with score >= min_score are
+                * considered + only front cover is used. If no match or error
+                * occurs, function returns nullopt.
+                */
+
+               auto esc_album = esc_quotes(album);
+               auto esc_artist = esc_quotes(artist);
+               std::string q
+                   = "(\"" + esc_album + "\"^2 OR alias:\"" + esc_album
+                     + "\")^3 AND (artistname:\"" + esc_artist
+                     + "\"^2 OR artist:\"" + esc_artist + "\"^2 OR label:\""
+                     + esc_artist
+                     + "\") AND (format:\"Digital Media\"^2 OR format:*)"
+                     + " AND NOT status:\"Pseudo-Release\"";
+               auto enc_q = uri_encode(q);
+               if (!enc_q)
+                    return std::nullopt;  // Skip retries, it’s unlikely to work
+               std::string req = "https://musicbrainz.org/ws/2/release?query="
+                                 + enc_q.value() + "&fmt=json";
+
+               // MB (get release MBID)
+               if (token.cancelled()) return std::nullopt;
+               auto mb_json = fetch_hedged(req, cancelled);
+               if (!mb_json) {
+                    AUDINFO(
+                        "Discord RPC: MusicBrainz sent a bad reply (task "
+                        "%llu)\r\n",
+                        token.this_req_id);
+                    continue;
+               }
+
+               auto mb = json::parse(*mb_json, nullptr, false);
+               if (mb.is_discarded() || !mb.is_object() || mb["count"] == 0
+                   || mb["releases"].empty()) {
+                    AUDINFO(
+                        "Discord RPC: MusicBrainz found no releases (task "
+                        "%llu)\r\n",
+                        token.this_req_id);
+                    return std::nullopt;
+               }
+               auto release = mb["releases"][0];
+               unsigned int score = release["score"].is_number_unsigned()
+                                        ? release["score"].get<unsigned int>()
+                                        : 0;
+               if (score < min_score)
+                    return std::nullopt;  // No good-enough match
+               std::string mbid = release["id"];
+               AUDINFO(
+                   "Discord RPC: MusicBrainz found release %s (task %llu)\r\n",
+                   mbid.c_str(), token.this_req_id);
+
+               // CAA (fetch all artwork)
+               if (token.cancelled()) return std::nullopt;
+               auto caa_reply = fetch_hedged_reply(
+                   "https://coverartarchive.org/release/" + mbid, "", "",
+                   cancelled);
+               if (!caa_reply) {
+                    AUDINFO(
+                        "Discord RPC: CAA sent a bad reply (task %llu)\r\n",
+                        token.this_req_id);
+                    continue;
+               }
+
+               // CAA (parse and find front cover)
+               auto image_url = caa_front_cover(caa_reply->body);
+               if (image_url)
+                    return CoverResult{
+                        *image_url, score,
+                        {caa_reply->etag, caa_reply->last_modified}};
+
+               AUDINFO(
+                   "Discord RPC: CAA found no front images (task %llu)\r\n",
+                   token.this_req_id);
+               return std::nullopt;
+
+          } while (++tries < FETCH_MAX_RETRIES);
+
+          AUDINFO(
+              "Discord RPC: MusicBrainz lookup failed after %u retries (task "
+              "%llu)\r\n",
+              FETCH_MAX_RETRIES, token.this_req_id);
+          return std::nullopt;
+     }
+};
+
+/* === iTunes Search API === */
+
+class ITunesProvider : public CoverProvider {
+   public:
+     ITunesProvider()
+         : CoverProvider(90, std::chrono::milliseconds(10000), false) {}
+
+     const char* name() const override { return "iTunes"; }
+
+     std::optional<CoverResult> lookup(
+         const std::string& artist, const std::string& album,
+         const LookupToken& token) const override {
+          // Nothing left to match on (e.g. all punctuation) would match all
+          const std::string n_artist = normalise(artist);
+          const std::string n_album = normalise(album);
+          if (n_artist.empty() || n_album.empty()) return std::nullopt;
+
+          auto enc_term = uri_encode(artist + " " + album);
+          if (!enc_term) return std::nullopt;
+          std::string req = "https://itunes.apple.com/search?term="
+                            + enc_term.value()
+                            + "&media=music&entity=album&limit=10";
+
+          if (token.cancelled()) return std::nullopt;
+          auto it_json
+              = fetch_hedged(req, [&token] { return token.cancelled(); });
+          if (!it_json) {
+               AUDINFO("Discord RPC: iTunes sent a bad reply (task %llu)\r\n",
+                       token.this_req_id);
+               return std::nullopt;
+          }
+
+          auto it = json::parse(*it_json, nullptr, false);
+          if (it.is_discarded() || !it.is_object() || !it.contains("results")
+              || !it["results"].is_array()) {
+               AUDINFO("Discord RPC: iTunes found no albums (task %llu)\r\n",
+                       token.this_req_id);
+               return std::nullopt;
+          }
+
+          /* iTunes has no relevance score of its own, so it is derived from
+           * how well the names match: both equal (100), album equal and one
+           * artist containing the other, e.g. "A feat. B" (95), or equal
+           * artist and the album followed by more words on iTunes, e.g.
+           * "Album (Deluxe Edition)" (90).
+           */
+
+          std::optional<CoverResult> best;
+          for (auto& result : it["results"]) {
+               if (!result.is_object() || !result["collectionName"].is_string()
+                   || !result["artistName"].is_string()
+                   || !result["artworkUrl100"].is_string())
+                    continue;
+
+               const std::string raw_album = result["collectionName"];
+               std::string r_artist
+                   = normalise(result["artistName"].get<std::string>());
+               std::string r_album = normalise(raw_album);
+               if (r_artist.empty() || r_album.empty()) continue;
+               bool artist_eq = r_artist == n_artist;
+               bool artist_in = r_artist.find(n_artist) != std::string::npos
+                                || n_artist.find(r_artist) != std::string::npos;
+               bool album_eq = r_album == n_album;
+               bool album_pre = starts_with_words(raw_album, n_album);
+
+               unsigned int score = 0;
+               if (artist_eq && album_eq)
+                    score = 100;
+               else if (album_eq && artist_in)
+                    score = 95;
+               else if (artist_eq && album_pre)
+                    score = 90;
+               if (best && score <= best->score) continue;
+
+               // 100×100 thumbnail by default, but any size can be requested
+               std::string url = result["artworkUrl100"];
+               auto size_pos = url.rfind("100x100bb");
+               if (size_pos != std::string::npos)
+                    url.replace(size_pos, 9, "512x512bb");
+               best = CoverResult{url, score, {}};
+          }
+
+          if (!best || best->score < min_score) {
+               AUDINFO(
+                   "Discord RPC: iTunes found no good match (task %llu)\r\n",
+                   token.this_req_id);
+               return std::nullopt;
+          }
+
+          AUDINFO("Discord RPC: iTunes found a cover (task %llu)\r\n",
+                  token.this_req_id);
+          return best;
+     }
+};
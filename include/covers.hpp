@@ -2,174 +2,329 @@
  * @file covers.hpp
  * @brief Cover art fetching functionality for Audacious Discord RPC.
  * @author onegen <onegen@onegen.dev>
- * @date 2025-11-27 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @license MIT
- * @copyright Copyright (c) 2025 onegen
+ * @copyright Copyright (c) 2025–2026 onegen
  *
  */
 
 #pragma once
 #define JSON_NOEXCEPTION
 
-#include <curl/curl.h>
-#include <nlohmann/json.hpp>
-
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 #include <string>
 #include <thread>
 
+#include "coverd.hpp"
 #include "covers-cache.hpp"
-
-#ifdef _WIN32
-#     include "fetch-win.hpp"  // Uses WinHTTP
-#else
-#     include "fetch-lin.hpp"  // Uses cURL (libcurl)
-#endif
-
-using json = nlohmann::json;
-
-constexpr unsigned int FETCH_DEBOUNCE = 2000;  // [ms]
-constexpr unsigned int FETCH_MAX_RETRIES = 5;
+#include "covers-providers.hpp"
+#include "stats.hpp"
 
 /* === Cache === */
 
 static CoverArtCache cache(
-    /* max_items */ 256,
+    /* max_items */ 8192,
     /* max_bytes (1 MiB) */ (1 << 20),
-    /* TTL (1 hr) */ std::chrono::seconds(3600));
-
-/* === Helpers === */
-
-inline std::string esc_quotes(const std::string& s) {
-     std::string r;
-     r.reserve(s.size());
-     for (char c : s)
-          if (c == '"' || c == '\\')
-               r += '\\', r += c;
-          else
-               r += c;
-     return r;
+    /* TTL (1 hr) */ std::chrono::seconds(3600),
+    /* kept stale (30 days) */ std::chrono::seconds(30 * 24 * 3600));
+
+/* Secondary key: tracks of one release usually embed the very same front
+ * cover, even if their album tags differ (discs, reissues, typos). A hash
+ * of the embedded image maps to the resolved URL under a reserved key. */
+#define ART_KEY_ARTIST "\x1E" "embedded-art"
+
+/** @brief 64-bit FNV-1a hash of the embedded cover (fast, not secure) */
+inline std::uint64_t art_fingerprint(const char* data, std::size_t len) {
+     std::uint64_t hash = 0xcbf29ce484222325ULL;
+     for (std::size_t i = 0; i < len; ++i) {
+          hash ^= static_cast<unsigned char>(data[i]);
+          hash *= 0x100000001b3ULL;
+     }
+     return hash;
+}
+
+inline std::string art_key(std::uint64_t art_hash) {
+     char hex[17];
+     snprintf(hex, sizeof(hex), "%016llx",
+              static_cast<unsigned long long>(art_hash));
+     return hex;
+}
+
+/* === Providers === */
+
+static MusicBrainzProvider musicbrainz_provider;
+static ITunesProvider itunes_provider;  // Opt-in, disabled by default
+
+static CoverProvider* const cover_providers[]
+    = {&musicbrainz_provider, &itunes_provider};
+
+/* === Provider Race === */
+
+/** @brief State of one race, shared with (possibly outliving) providers */
+struct CoverRace {
+     std::mutex mtx;
+     std::condition_variable cv;
+     std::optional<CoverResult> winner;
+     std::size_t pending = 0;  //< Providers yet to report back
+     LookupToken token;
+};
+
+/**
+ * @brief Queries all enabled providers at once, first acceptable result wins.
+ *
+ * A result is acceptable if it scores at least the provider’s min_score and
+ * arrives within its timeout. Once decided (or once every provider finished
+ * or timed out), the token is settled, which cancels the remaining providers
+ * including their in-flight requests.
+ *
+ * @param providers Providers to race (must outlive the race)
+ */
+static std::optional<CoverResult> cover_race(
+    const std::string& artist, const std::string& album,
+    const std::atomic<unsigned long long>* active_req_id,
+    unsigned long long this_req_id,
+    std::span<CoverProvider* const> providers = cover_providers) {
+     using clk = std::chrono::steady_clock;
+
+     auto race = std::make_shared<CoverRace>();
+     race->token.active_req_id = active_req_id;
+     race->token.this_req_id = this_req_id;
+
+     const auto start = clk::now();
+     auto deadline = start;
+     for (CoverProvider* provider : providers) {
+          if (!provider->enabled.load()) continue;
+          const auto provider_deadline = start + provider->timeout;
+          deadline = std::max(deadline, provider_deadline);
+
+          std::lock_guard<std::mutex> lock(race->mtx);
+          ++race->pending;
+          RPCStats::bump(stats.threads);
+          std::thread([race, provider, provider_deadline, artist, album] {
+               auto res = provider->lookup(artist, album, race->token);
+
+               std::lock_guard<std::mutex> lock(race->mtx);
+               --race->pending;
+               if (res && res->score >= provider->min_score
+                   && clk::now() <= provider_deadline
+                   && !race->token.cancelled()) {
+                    race->winner = std::move(res);
+                    race->token.settled.store(true);
+                    AUDINFO(
+                        "Discord RPC: %s won the cover race (task %llu)\r\n",
+                        provider->name(), race->token.this_req_id);
+               }
+               race->cv.notify_all();
+          }).detach();
+     }
+
+     std::unique_lock<std::mutex> lock(race->mtx);
+     while (!race->winner && race->pending > 0 && clk::now() < deadline
+            && !race->token.cancelled())
+          // Wake up periodically to notice superseding requests
+          race->cv.wait_for(lock, std::chrono::milliseconds(100));
+
+     race->token.settled.store(true);  // Stop all stragglers
+     return race->winner;
 }
 
-inline bool is_cancelled(const std::atomic<unsigned long long>* active_req_id,
-                         unsigned long long this_req_id) {
-     return active_req_id && (this_req_id != active_req_id->load());
+/* === Revalidation === */
+
+/**
+ * @brief Revalidates an expired cover with a conditional CAA request.
+ *
+ * Covers hardly ever change, so instead of searching MusicBrainz again, the
+ * release listing the expired URL came from (its MBID is part of the compact
+ * value) is requested with the validators of the last reply. A 304 keeps the
+ * URL without a body to transfer or parse; a changed listing is parsed as in
+ * a full lookup. Anything else returns nullopt, for a full lookup instead.
+ */
+static std::optional<CoverResult> cover_revalidate(
+    const std::string& artist, const std::string& album,
+    const std::function<bool()>& cancelled = nullptr) {
+     using clk = std::chrono::steady_clock;
+
+     auto stale = cache.get_stale(artist, album);
+     if (!stale || !stale->release || stale->validators.empty())
+          return std::nullopt;
+
+     const auto start = clk::now();
+     auto reply = fetch_hedged_reply(
+         "https://coverartarchive.org/release/" + *stale->release,
+         stale->validators.etag, stale->validators.last_modified, cancelled);
+     if (!reply) return std::nullopt;
+     [[maybe_unused]] const long long ms
+         = std::chrono::duration_cast<std::chrono::milliseconds>(clk::now()
+                                                                 - start)
+               .count();
+
+     if (reply->status == 304) {
+          AUDINFO(
+              "Discord RPC: Cover of release %s not modified (%zu B, %lld "
+              "ms)\r\n",
+              stale->release->c_str(), reply->bytes, ms);
+          RPCStats::bump(stats.revalidated);
+          return CoverResult{stale->url, 100, stale->validators};
+     }
+
+     auto url = reply->status == 200 ? caa_front_cover(reply->body)
+                                     : std::nullopt;
+     if (!url) return std::nullopt;
+     AUDINFO("Discord RPC: Cover of release %s changed (%zu B, %lld ms)\r\n",
+             stale->release->c_str(), reply->bytes, ms);
+     return CoverResult{*url, 100, {reply->etag, reply->last_modified}};
+}
+
+/** @brief Caches a cover under its tags and, if known, its embedded art */
+static void cover_cache_put(const std::string& artist,
+                            const std::string& album, std::uint64_t art_hash,
+                            const std::string& url,
+                            const CoverValidators& validators) {
+     cache.put(artist, album, url, validators);
+     if (art_hash)
+          cache.put(ART_KEY_ARTIST, art_key(art_hash), url, validators);
+}
+
+/* === Background Refresh === */
+
+/* Keys being refreshed, so a cover played again meanwhile (or asked for
+ * by several daemon clients) is only refreshed once */
+static std::mutex refreshing_mtx;
+static std::set<std::string> refreshing;
+
+/**
+ * @brief Refreshes an expired cover in the background (stale-while-
+ *        revalidate).
+ *
+ * The caller serves the stale URL right away, since covers hardly ever
+ * change. This brings the entry up to date for next time: revalidated if
+ * possible, else looked up in full. If both fail, the stale entry stays.
+ *
+ * @param active_req_id Cancels (and debounces) the refresh like a lookup
+ *                      with the same IDs; nullptr = never cancelled
+ * @param art_hash Fingerprint of the embedded cover (0 = none)
+ * @param on_refreshed Called (on the refreshing thread) once the cache got
+ *                     the refreshed cover
+ */
+static void cover_refresh(
+    const std::string& artist, const std::string& album,
+    const std::atomic<unsigned long long>* active_req_id = nullptr,
+    unsigned long long this_req_id = 0, std::uint64_t art_hash = 0,
+    std::function<void()> on_refreshed = nullptr) {
+     const std::string k = CoverArtCache::key(artist, album);
+     {
+          std::lock_guard<std::mutex> lock(refreshing_mtx);
+          if (!refreshing.insert(k).second) return;
+     }
+
+     RPCStats::bump(stats.threads);
+     std::thread([artist, album, k, active_req_id, this_req_id, art_hash,
+                  on_refreshed] {
+          auto cancelled = [=] {
+               return is_cancelled(active_req_id, this_req_id);
+          };
+          // Skipped tracks are not worth refreshing yet
+          for (unsigned int slept = 0; active_req_id && slept < FETCH_DEBOUNCE
+                                       && !cancelled();
+               slept += 100)
+               std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+          std::optional<CoverResult> res;
+          if (!cancelled()) res = cover_revalidate(artist, album, cancelled);
+          if (!res && !cancelled())
+               res = cover_race(artist, album, active_req_id, this_req_id);
+          if (res) {
+               cover_cache_put(artist, album, art_hash, res->url,
+                               res->validators);
+               if (on_refreshed) on_refreshed();
+          }
+
+          std::lock_guard<std::mutex> lock(refreshing_mtx);
+          refreshing.erase(k);
+     }).detach();
 }
 
 /* === Exported Function === */
 
+/** @param art_hash Fingerprint of the embedded cover (0 = none) */
 std::optional<std::string> cover_lookup(
     const std::string& artist, const std::string& album,
     const std::atomic<unsigned long long>* active_req_id = nullptr,
-    unsigned long long this_req_id = 0) {
-     // Cache
+    unsigned long long this_req_id = 0, std::uint64_t art_hash = 0) {
+     RPCStats::bump(stats.cover_lookups);
+
+     // Cache (tags first, then embedded art, then expired tags)
      auto cache_res = cache.get(artist, album);
      if (cache_res.has_value()) {
           AUDINFO("Discord RPC: Cover art cache hit!\r\n");
+          RPCStats::bump(stats.cover_tag_hits);
           return cache_res;
-     } else {
-          AUDDBG("Discord RPC: Cover art cache miss, continuing...\r\n");
      }
-
-     unsigned int tries = 0;
-     do {
-          // 2 second debounce (in case user is mashing NEXT)
-          for (int i = 0; i < 20; ++i) {
-               // 20 sleeps × 100 ms = 2000 ms = 2 s
-               if (is_cancelled(active_req_id, this_req_id))
-                    return std::nullopt;
-               std::this_thread::sleep_for(std::chrono::milliseconds(100));
+     if (art_hash) {
+          // With its validators, so the tags' entry can be revalidated too
+          CoverValidators validators;
+          cache_res = cache.get(ART_KEY_ARTIST, art_key(art_hash), &validators);
+          if (cache_res.has_value()) {
+               AUDINFO("Discord RPC: Cover art cache hit (embedded art)!\r\n");
+               RPCStats::bump(stats.cover_art_hits);
+               cache.put(artist, album, *cache_res, validators);
+               return cache_res;
           }
+     }
+     // Expired cover (e.g. warmed long ago) is shown now, refreshed later
+     if (auto stale = cache.get_stale(artist, album)) {
+          AUDINFO("Discord RPC: Cover art cache hit (stale, task %llu)!\r\n",
+                  this_req_id);
+          RPCStats::bump(stats.cover_stale_hits);
+          cover_refresh(artist, album, active_req_id, this_req_id, art_hash);
+          return stale->url;
+     }
+     AUDDBG("Discord RPC: Cover art cache miss, continuing...\r\n");
 
-          /* The query disregards the track artist, focusing on the album artist
-           * a la LastFM. Album title is prioritised over album alias. Artist
-           * name is also checked for label (for compilations, like Monstercat,
-           * which MB often tags as "Various Artists") but most users use
-           * "Monstercat". Artist match is slightly prioritised over label. All
-           * formats are accepted (for e.g. CD rips) but digital media has
-           * slight priority. Only matches with score >= 90 are considered
-           * + only front cover is used. If no match or error occurs, function
-           * returns nullopt (Audacious logo shown instead).
-           */
-
-          auto esc_album = esc_quotes(album);
-          auto esc_artist = esc_quotes(artist);
-          std::string q = "(\"" + esc_album + "\"^2 OR alias:\"" + esc_album
-                          + "\")^3 AND (artistname:\"" + esc_artist
-                          + "\"^2 OR artist:\"" + esc_artist
-                          + "\"^2 OR label:\"" + esc_artist
-                          + "\") AND (format:\"Digital Media\"^2 OR format:*)"
-                          + " AND NOT status:\"Pseudo-Release\"";
-          auto enc_q = uri_encode(q);
-          if (!enc_q)
-               return std::nullopt;  // Skip retries, it’s unlikely to work
-          std::string req = "https://musicbrainz.org/ws/2/release?query="
-                            + enc_q.value() + "&fmt=json";
-
-          // MB (get release MBID)
+     // 2 second debounce (in case user is mashing NEXT)
+     for (unsigned int slept = 0; slept < FETCH_DEBOUNCE; slept += 100) {
           if (is_cancelled(active_req_id, this_req_id)) return std::nullopt;
-          auto mb_json = fetch(req);
-          if (!mb_json) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+     }
+
+     // Shared daemon, if running (it de-duplicates and rate-limits lookups)
+     std::string daemon_url;
+     switch (coverd_lookup(artist, album, daemon_url, active_req_id,
+                           this_req_id)) {
+          case CoverdReply::Hit:
                AUDINFO(
-                   "Discord RPC: MusicBrainz sent a bad reply (task %llu)\r\n",
+                   "Discord RPC: Cover daemon found a cover (task %llu)\r\n",
                    this_req_id);
-               continue;
-          }
-
-          auto mb = json::parse(*mb_json, nullptr, false);
-          if (mb.is_discarded() || !mb.is_object() || mb["count"] == 0
-              || mb["releases"].empty()) {
+               cover_cache_put(artist, album, art_hash, daemon_url,
+                               CoverValidators());
+               return daemon_url;
+          case CoverdReply::Miss:
                AUDINFO(
-                   "Discord RPC: MusicBrainz found no releases (task %llu)\r\n",
+                   "Discord RPC: Cover daemon found no cover (task %llu)\r\n",
                    this_req_id);
                return std::nullopt;
-          }
-          auto release = mb["releases"][0];
-          if (release["score"] < 90)
-               return std::nullopt;  // No good-enough match
-          std::string mbid = release["id"];
-          AUDINFO("Discord RPC: MusicBrainz found release %s (task %llu)\r\n",
-                  mbid.c_str(), this_req_id);
-
-          // CAA (fetch all artwork)
-          if (is_cancelled(active_req_id, this_req_id)) return std::nullopt;
-          auto caa_json = fetch("https://coverartarchive.org/release/" + mbid);
-          if (!caa_json) {
-               AUDINFO("Discord RPC: CAA sent a bad reply (task %llu)\r\n",
-                       this_req_id);
-               continue;
-          }
-
-          // CAA (parse and find front cover)
-          auto caa = json::parse(*caa_json, nullptr, false);
-          if (caa.is_discarded() || !caa.is_object() || caa["images"].empty()) {
-               AUDINFO("Discord RPC: CAA found no images (task %llu)\r\n",
-                       this_req_id);
-               return std::nullopt;
-          }
-
-          for (auto& image : caa["images"]) {
-               if (image.contains("front") && image["front"] == true
-                   && image.contains("thumbnails")
-                   && image["thumbnails"].contains("large")) {
-                    std::string image_url = image["thumbnails"]["large"];
-                    cache.put(artist, album, image_url);
-                    AUDINFO(
-                        "Discord RPC: CAA found a front image (task %llu)\r\n",
-                        this_req_id);
-                    return image_url;
-               }
-          }
+          case CoverdReply::Unavailable:
+               break;
+     }
 
-          AUDINFO("Discord RPC: CAA found no front images (task %llu)\r\n",
+     // (Expired covers never get here: they are refreshed in the background)
+     auto res = cover_race(artist, album, active_req_id, this_req_id);
+     if (!res) {
+          AUDINFO("Discord RPC: No provider found a cover (task %llu)\r\n",
                   this_req_id);
           return std::nullopt;
+     }
 
-     } while (++tries < FETCH_MAX_RETRIES);
-
-     AUDINFO(
-         "Discord RPC: Cover art fetch failed after %u retries (task %llu)\r\n",
-         FETCH_MAX_RETRIES, this_req_id);
-     return std::nullopt;
-}
\ No newline at end of file
+     cover_cache_put(artist, album, art_hash, res->url, res->validators);
+     return res->url;
+}
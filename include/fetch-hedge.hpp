@@ -0,0 +1,271 @@
+/**
+ * @file fetch-hedge.hpp
+ * @brief Request hedging on top of the platform fetch_reply().
+ * @note Made for Audacious-Discord-RPC project.
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note If a request is not answered within the p95 latency observed for its
+ *       host, one duplicate is sent on a new connection and whichever reply
+ *       arrives first is used; the other request is cancelled. Hedges are
+ *       capped to a fraction of recent requests, so a slow host cannot
+ *       double the load put on it.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "rate-limit.hpp"
+#include "stats.hpp"
+
+#if defined(RPC_FETCH_HEADER)
+#     include RPC_FETCH_HEADER  // Stand-in, e.g. for tools/replay.cpp
+#elif defined(_WIN32)
+#     include "fetch-win.hpp"  // Uses WinHTTP
+#else
+#     include "fetch-lin.hpp"  // Uses cURL (libcurl)
+#endif
+
+constexpr std::size_t HEDGE_SAMPLES = 64;      // Latencies kept per host
+constexpr std::size_t HEDGE_MIN_SAMPLES = 16;  // Fewer => no hedging
+constexpr unsigned int HEDGE_BUDGET = 10;      // Max. hedges per 100 requests
+constexpr unsigned int HEDGE_BURST = 2;        // Max. hedges saved up
+
+static std::atomic<bool> fetch_hedging{false};  //< Hedging enabled
+static RateLimiter* fetch_limiter = nullptr;    //< Optional, set before use
+
+/* === Latency Tracking === */
+
+/** @brief Ring buffers of recent successful request latencies per host */
+class HostLatencies {
+   public:
+     using ms = std::chrono::milliseconds;
+
+     static std::string host(const std::string& url) {
+          auto begin = url.find("://");
+          begin = (begin == std::string::npos) ? 0 : begin + 3;
+          auto end = url.find('/', begin);
+          if (end != std::string::npos) end -= begin;
+          return url.substr(begin, end);
+     }
+
+     void record(const std::string& host, ms latency) {
+          std::lock_guard<std::mutex> lock(mtx);
+          Samples& s = hosts[host];
+          if (s.ring.size() < HEDGE_SAMPLES)
+               s.ring.push_back(latency);
+          else
+               s.ring[s.next] = latency;
+          s.next = (s.next + 1) % HEDGE_SAMPLES;
+     }
+
+     std::optional<ms> p95(const std::string& host) {
+          return percentile(host, 95);
+     }
+
+     /** @brief Latency under which `pct` % of the kept samples are */
+     std::optional<ms> percentile(const std::string& host, unsigned int pct) {
+          std::vector<ms> sorted;
+          {
+               std::lock_guard<std::mutex> lock(mtx);
+               auto it = hosts.find(host);
+               if (it == hosts.end()
+                   || it->second.ring.size() < HEDGE_MIN_SAMPLES)
+                    return std::nullopt;
+               sorted = it->second.ring;
+          }
+
+          pct = std::clamp(pct, 1u, 100u);
+          auto nth = sorted.begin() + ((sorted.size() * pct + 99) / 100) - 1;
+          std::nth_element(sorted.begin(), nth, sorted.end());
+          return *nth;
+     }
+
+   private:
+     struct Samples {
+          std::vector<ms> ring;
+          std::size_t next = 0;  //< Slot to overwrite once full
+     };
+
+     std::mutex mtx;
+     std::unordered_map<std::string, Samples> hosts;
+};
+
+static HostLatencies latencies;
+
+/* === Request Budget === */
+
+static std::atomic<unsigned long long> requests_sent{0};
+static std::atomic<unsigned long long> hedges_sent{0};
+
+/* Token bucket in hundredths of a hedge: each original request adds
+ * HEDGE_BUDGET, each hedge takes 100. The cap keeps a long quiet stretch
+ * from saving up a burst of hedges for when a host slows down. */
+static std::atomic<unsigned int> hedge_tokens{0};
+
+/** @brief Adds an original request's share of a hedge to the budget */
+inline void hedge_budget_refill() {
+     constexpr unsigned int cap = HEDGE_BURST * 100;
+     auto tokens = hedge_tokens.load();
+     while (tokens < cap
+            && !hedge_tokens.compare_exchange_weak(
+                tokens, std::min(tokens + HEDGE_BUDGET, cap))) {
+     }
+}
+
+/** @brief Takes a hedge from the budget, if there is one left */
+inline bool hedge_budget_take() {
+     auto tokens = hedge_tokens.load();
+     do {
+          if (tokens < 100) return false;
+     } while (!hedge_tokens.compare_exchange_weak(tokens, tokens - 100));
+     ++hedges_sent;
+     return true;
+}
+
+/* === Exported Functions === */
+
+/** @brief State of one hedged request, shared with its (detached) attempts */
+struct HedgeState {
+     std::mutex mtx;
+     std::condition_variable cv;
+     std::optional<FetchReply> result;
+     /* Original attempt left the limiter; the hedge timer and the recorded
+      * latency both count from here, as queueing is not latency */
+     std::optional<std::chrono::steady_clock::time_point> origin;
+     unsigned int pending = 0;       //< Attempts still running
+     std::atomic<bool> done{false};  //< Attempts should stop
+};
+
+/**
+ * @brief fetch_reply(), hedged once past the host’s p95 latency (if enabled).
+ * @note `cancelled` is only polled by the calling thread, never by the
+ *       attempts, which may outlive this call.
+ * @note A hedged request records one latency: from the original attempt to
+ *       the first reply, whichever attempt sent it. Timing the winner from
+ *       its own start (and never the cancelled original) would only sample
+ *       the fast part of the distribution and drag the p95 down over time.
+ */
+static std::optional<FetchReply> fetch_hedged_reply(
+    const std::string& url, const std::string& etag = "",
+    const std::string& last_modified = "",
+    const std::function<bool()>& cancelled = nullptr) noexcept {
+     using clk = std::chrono::steady_clock;
+
+     const std::string host = HostLatencies::host(url);
+     const auto hedge_after
+         = fetch_hedging.load() ? latencies.p95(host) : std::nullopt;
+     if (!hedge_after) {
+          // Nothing to hedge against yet, just keep the statistics
+          if (fetch_limiter && !fetch_limiter->acquire(host, cancelled))
+               return std::nullopt;
+          const auto start = clk::now();
+          ++requests_sent;
+          hedge_budget_refill();
+          RPCStats::bump(stats.fetches);
+          auto res = fetch_reply(url, etag, last_modified, cancelled);
+          if (res) {
+               latencies.record(host,
+                                std::chrono::duration_cast<HostLatencies::ms>(
+                                    clk::now() - start));
+               RPCStats::add(stats.fetch_bytes, res->bytes);
+          }
+          return res;
+     }
+
+     auto state = std::make_shared<HedgeState>();
+
+     auto launch = [&state, &url, &host, &etag, &last_modified](bool hedge) {
+          ++requests_sent;
+          if (!hedge) hedge_budget_refill();
+          ++state->pending;
+          RPCStats::bump(stats.fetches);
+          RPCStats::bump(stats.threads);
+          std::thread([state, url, host, etag, last_modified, hedge] {
+               auto stop = [&state] { return state->done.load(); };
+               std::optional<FetchReply> res;
+               if (!fetch_limiter || fetch_limiter->acquire(host, stop)) {
+                    if (!hedge) {
+                         std::lock_guard<std::mutex> lock(state->mtx);
+                         state->origin = clk::now();
+                         state->cv.notify_all();  // Hedge timer starts
+                    }
+                    res = fetch_reply(url, etag, last_modified, stop);
+               }
+
+               std::lock_guard<std::mutex> lock(state->mtx);
+               --state->pending;
+               if (res) {
+                    RPCStats::add(stats.fetch_bytes, res->bytes);
+                    if (!state->result) {
+                         if (state->origin)
+                              latencies.record(
+                                  host,
+                                  std::chrono::duration_cast<
+                                      HostLatencies::ms>(clk::now()
+                                                         - *state->origin));
+                         if (hedge)
+                              AUDDBG(
+                                  "Discord RPC: Hedged request to %s won\r\n",
+                                  host.c_str());
+                         state->result = std::move(res);
+                         state->done.store(true);
+                    }
+               }
+               state->cv.notify_all();
+          }).detach();
+     };
+
+     std::unique_lock<std::mutex> lock(state->mtx);
+     bool hedged = false;
+     launch(false);
+
+     while (!state->result && state->pending > 0) {
+          if (cancelled && cancelled()) break;
+
+          // A hedge would queue behind the original, so its timer waits too
+          if (!hedged && state->origin
+              && clk::now() - *state->origin >= *hedge_after) {
+               hedged = true;  // At most one duplicate, budget or not
+               if (hedge_budget_take()) {
+                    AUDDBG("Discord RPC: Hedging a request to %s\r\n",
+                           host.c_str());
+                    launch(true);
+               }
+          }
+
+          // Wake up periodically to check cancellation, and on hedging time
+          auto wake = clk::now() + std::chrono::milliseconds(50);
+          if (!hedged && state->origin)
+               wake = std::min(wake, *state->origin + *hedge_after);
+          state->cv.wait_until(lock, wake);
+     }
+
+     state->done.store(true);  // Cancel whichever attempt is left
+     return state->result;
+}
+
+/** @brief Body of a GET, hedged once past the host’s p95 (if enabled) */
+static std::optional<std::string> fetch_hedged(
+    const std::string& url,
+    const std::function<bool()>& cancelled = nullptr) noexcept {
+     auto reply = fetch_hedged_reply(url, "", "", cancelled);
+     if (!reply) return std::nullopt;
+     return std::move(reply->body);
+}
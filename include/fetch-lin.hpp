@@ -3,7 +3,7 @@
  * @brief cURL-based HTTP fetcher for use on Linux.
  * @note Made for Audacious-Discord-RPC project.
  * @author onegen <onegen@onegen.dev>
- * @date 2025-11-24 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @license MIT
  * @copyright Copyright (c) 2025 onegen
@@ -14,6 +14,10 @@
 
 #include <curl/curl.h>
 
+#include <strings.h>
+
+#include <cstring>
+#include <functional>
 #include <optional>
 #include <string>
 
@@ -29,6 +33,15 @@
 
 constexpr unsigned long FETCH_TIMEO = 15000;  // [ms]
 
+/** @brief Reply of fetch_reply(), with what conditional requests need */
+struct FetchReply {
+     long status = 0;            //< HTTP status (304 = not modified)
+     std::string body;           //< Empty on 304
+     std::string etag;           //< ETag validator, if sent
+     std::string last_modified;  //< Last-Modified validator, if sent
+     std::size_t bytes = 0;      //< Bytes received (headers + body)
+};
+
 /* === Helpers === */
 
 /** @brief Write callback for cURL */
@@ -37,38 +50,108 @@ static size_t write_cb(void* c, size_t s, size_t n, void* u) {
      return s * n;
 }
 
-/* === Exported Function === */
+/** @brief Header callback for cURL, keeps the validators of the last reply */
+static size_t header_cb(char* c, size_t s, size_t n, void* u) {
+     auto* reply = static_cast<FetchReply*>(u);
+     std::string line(c, s * n);
+     while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+          line.pop_back();
+
+     auto value_of = [&line](const char* name) -> std::optional<std::string> {
+          std::size_t len = strlen(name);
+          if (line.size() <= len || strncasecmp(line.c_str(), name, len) != 0)
+               return std::nullopt;
+          std::size_t start = line.find_first_not_of(' ', len);
+          if (start == std::string::npos) return std::string();
+          return line.substr(start);
+     };
+     if (line.starts_with("HTTP/")) {
+          // New reply (e.g. after a redirect), forget the previous one's
+          reply->etag.clear();
+          reply->last_modified.clear();
+     } else if (auto etag = value_of("ETag:")) {
+          reply->etag = *etag;
+     } else if (auto last_modified = value_of("Last-Modified:")) {
+          reply->last_modified = *last_modified;
+     }
+     return s * n;
+}
+
+/** @brief Progress callback for cURL, aborts the transfer once cancelled */
+static int xferinfo_cb(void* u, curl_off_t, curl_off_t, curl_off_t,
+                       curl_off_t) {
+     return (*static_cast<const std::function<bool()>*>(u))() ? 1 : 0;
+}
+
+/* === Exported Functions === */
 
 /** @brief User-Agent */
 static const char* ua
     = "Audacious Discord RPC/2.2 "
       "(+https://github.com/onegen-dev/audacious-discord-rpc)";
 
-static std::optional<std::string> fetch(const std::string& url) noexcept {
+/**
+ * @brief GET request, conditional if validators of a cached reply are given.
+ * @note The validators are sent as If-None-Match and If-Modified-Since; an
+ *       unchanged resource is then answered with 304 and no body.
+ */
+static std::optional<FetchReply> fetch_reply(
+    const std::string& url, const std::string& etag = "",
+    const std::string& last_modified = "",
+    const std::function<bool()>& cancelled = nullptr) noexcept {
      CURL* c = curl_easy_init();
      if (!c) return std::nullopt;
-     std::string buf;
+     FetchReply reply;
+     struct curl_slist* headers = nullptr;
+     if (!etag.empty())
+          headers = curl_slist_append(headers,
+                                      ("If-None-Match: " + etag).c_str());
+     if (!last_modified.empty())
+          headers = curl_slist_append(
+              headers, ("If-Modified-Since: " + last_modified).c_str());
      curl_easy_setopt(c, CURLOPT_URL, url.c_str());
      curl_easy_setopt(c, CURLOPT_USERAGENT, ua);
+     curl_easy_setopt(c, CURLOPT_HTTPHEADER, headers);
      curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, write_cb);
-     curl_easy_setopt(c, CURLOPT_WRITEDATA, &buf);
+     curl_easy_setopt(c, CURLOPT_WRITEDATA, &reply.body);
+     curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, header_cb);
+     curl_easy_setopt(c, CURLOPT_HEADERDATA, &reply);
      curl_easy_setopt(c, CURLOPT_TIMEOUT_MS, FETCH_TIMEO);
      curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT_MS, FETCH_TIMEO);
      curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
-     curl_easy_setopt(c, CURLOPT_NOPROGRESS, 1L);
+     if (cancelled) {
+          curl_easy_setopt(c, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
+          curl_easy_setopt(c, CURLOPT_XFERINFODATA, &cancelled);
+          curl_easy_setopt(c, CURLOPT_NOPROGRESS, 0L);
+     } else {
+          curl_easy_setopt(c, CURLOPT_NOPROGRESS, 1L);
+     }
      curl_easy_setopt(c, CURLOPT_FAILONERROR, 0L);
      curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
      curl_easy_setopt(c, CURLOPT_TCP_FASTOPEN, 1L);
      curl_easy_setopt(c, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
      curl_easy_setopt(c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
      CURLcode r = curl_easy_perform(c);
+     if (r == CURLE_OK) {
+          curl_off_t body_size = 0;
+          long header_size = 0;
+          curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &reply.status);
+          curl_easy_getinfo(c, CURLINFO_SIZE_DOWNLOAD_T, &body_size);
+          curl_easy_getinfo(c, CURLINFO_HEADER_SIZE, &header_size);
+          reply.bytes = static_cast<std::size_t>(body_size + header_size);
+     }
      curl_easy_cleanup(c);
+     curl_slist_free_all(headers);
+     if (r == CURLE_ABORTED_BY_CALLBACK) {
+          AUDDBG("Discord RPC cURL fetch cancelled\r\n");
+          return std::nullopt;
+     }
      if (r != CURLE_OK) {
           AUDINFO("Discord RPC cURL fetch failed, err = %d\r\n", r);
           return std::nullopt;
      }
 
-     return buf;
+     return reply;
 }
 
 static std::optional<std::string> uri_encode(const std::string& str) noexcept {
@@ -3,7 +3,7 @@
  * @brief WinHTTP-based fetcher for use on Windows 10+.
  * @note Made for Audacious-Discord-RPC project.
  * @author onegen <onegen@onegen.dev>
- * @date 2025-11-24 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @license MIT
  * @copyright Copyright (c) 2025 onegen
@@ -17,6 +17,7 @@
 #include <winhttp.h>
 
 #include <codecvt>
+#include <functional>
 #include <optional>
 #include <string>
 
@@ -32,6 +33,15 @@
 
 constexpr DWORD FETCH_TIMEO = 15000;  // [ms]
 
+/** @brief Reply of fetch_reply(), with what conditional requests need */
+struct FetchReply {
+     long status = 0;            //< HTTP status (304 = not modified)
+     std::string body;           //< Empty on 304
+     std::string etag;           //< ETag validator, if sent
+     std::string last_modified;  //< Last-Modified validator, if sent
+     std::size_t bytes = 0;      //< Bytes received (headers + body)
+};
+
 /* === Helpers === */
 
 /**
@@ -67,14 +77,43 @@ static std::string GetLastErrorAsString() {
      return msg;
 }
 
-/* === Exported Function === */
+/** @brief Gets a response header as a (UTF-8) string, empty if not sent */
+static std::string query_header(HINTERNET req, DWORD info) {
+     DWORD size = 0;
+     WinHttpQueryHeaders(req, info, WINHTTP_HEADER_NAME_BY_INDEX, NULL, &size,
+                         WINHTTP_NO_HEADER_INDEX);
+     if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || size == 0) return "";
+
+     std::wstring wval(size / sizeof(wchar_t), 0);
+     if (!WinHttpQueryHeaders(req, info, WINHTTP_HEADER_NAME_BY_INDEX,
+                              &wval[0], &size, WINHTTP_NO_HEADER_INDEX))
+          return "";
+     wval.resize(size / sizeof(wchar_t));
+
+     int len = WideCharToMultiByte(CP_UTF8, 0, wval.c_str(), wval.size(), NULL,
+                                   0, NULL, NULL);
+     std::string val(len, 0);
+     WideCharToMultiByte(CP_UTF8, 0, wval.c_str(), wval.size(), &val[0], len,
+                         NULL, NULL);
+     return val;
+}
+
+/* === Exported Functions === */
 
 /** @brief User-Agent */
 static const wchar_t* ua
     = L"Audacious-Discord-RPC/2.2 "
       "(+https://github.com/onegen-dev/audacious-discord-rpc)";
 
-static std::optional<std::string> fetch(const std::string& url) noexcept {
+/**
+ * @brief GET request, conditional if validators of a cached reply are given.
+ * @note The validators are sent as If-None-Match and If-Modified-Since; an
+ *       unchanged resource is then answered with 304 and no body.
+ */
+static std::optional<FetchReply> fetch_reply(
+    const std::string& url, const std::string& etag = "",
+    const std::string& last_modified = "",
+    const std::function<bool()>& cancelled = nullptr) noexcept {
      std::wstring wurl = wstringify(url);
 
      /** @cite
@@ -123,6 +162,14 @@ static std::optional<std::string> fetch(const std::string& url) noexcept {
 
      bool res = WinHttpSetTimeouts(req, FETCH_TIMEO, FETCH_TIMEO, FETCH_TIMEO,
                                    FETCH_TIMEO);
+     if (res && !etag.empty())
+          res = WinHttpAddRequestHeaders(
+              req, wstringify("If-None-Match: " + etag).c_str(), (DWORD)-1L,
+              WINHTTP_ADDREQ_FLAG_ADD);
+     if (res && !last_modified.empty())
+          res = WinHttpAddRequestHeaders(
+              req, wstringify("If-Modified-Since: " + last_modified).c_str(),
+              (DWORD)-1L, WINHTTP_ADDREQ_FLAG_ADD);
      if (res) res |= WinHttpSendRequest(req, NULL, 0, NULL, 0, 0, 0);
      if (res) res |= WinHttpReceiveResponse(req, NULL);
      if (!res) {
@@ -132,11 +179,32 @@ static std::optional<std::string> fetch(const std::string& url) noexcept {
           return std::nullopt;
      }
 
-     std::string data;
+     FetchReply reply;
+     DWORD status = 0;
+     DWORD status_size = sizeof(status);
+     if (WinHttpQueryHeaders(req,
+                             WINHTTP_QUERY_STATUS_CODE
+                                 | WINHTTP_QUERY_FLAG_NUMBER,
+                             WINHTTP_HEADER_NAME_BY_INDEX, &status,
+                             &status_size, WINHTTP_NO_HEADER_INDEX))
+          reply.status = status;
+     reply.etag = query_header(req, WINHTTP_QUERY_ETAG);
+     reply.last_modified = query_header(req, WINHTTP_QUERY_LAST_MODIFIED);
+     reply.bytes = query_header(req, WINHTTP_QUERY_RAW_HEADERS_CRLF).size();
+
+     std::string& data = reply.body;
      unsigned long n_read = 0;
      unsigned long n_available = 0;
 
      do {
+          /* WinHTTP has no progress callback in synchronous mode,
+           * so cancellation is only checked between reads. */
+          if (cancelled && cancelled()) {
+               AUDDBG("Discord RPC WinHTTP fetch cancelled\r\n");
+               cleanup();
+               return std::nullopt;
+          }
+
           if (!WinHttpQueryDataAvailable(req, &n_available)) {
                AUDINFO("Discord RPC WinHTTP fetch failed: %s\r\n",
                        GetLastErrorAsString().c_str());
@@ -168,7 +236,8 @@ static std::optional<std::string> fetch(const std::string& url) noexcept {
      } while (n_available > 0);
      cleanup();
 
-     return data;
+     reply.bytes += data.size();
+     return reply;
 }
 
 static std::optional<std::string> uri_encode(const std::string& str) noexcept {
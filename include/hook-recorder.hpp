@@ -0,0 +1,90 @@
+/**
+ * @file hook-recorder.hpp
+ * @brief Hook event recorder for Audacious Discord RPC.
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Enabled by setting AUD_DISCORD_RPC_RECORD to a file path before
+ *       starting Audacious. Every hook the plugin receives is appended as
+ *       one tab-separated line with a timestamp and a snapshot of the
+ *       playback state and tuple, so heavy sessions (skip storms, radio
+ *       title floods, pause spam) can be captured and replayed.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <libaudcore/drct.h>
+#include <libaudcore/runtime.h>
+#include <libaudcore/tuple.h>
+
+#include <chrono>
+#include <cstdio>
+
+#define RECORD_ENV "AUD_DISCORD_RPC_RECORD"
+
+class HookRecorder {
+   public:
+     using clk = std::chrono::steady_clock;
+
+     bool open(const char* path) {
+          close();
+          file = fopen(path, "a");
+          if (!file) return false;
+          start = clk::now();
+          fprintf(file,
+                  "#ms\thook\tplaying\tready\tpaused\ttime\tfilename\ttitle\t"
+                  "artist\talbum\talbum_artist\tlength\n");
+          return true;
+     }
+
+     void close() {
+          if (file) fclose(file);
+          file = nullptr;
+     }
+
+     bool active() const { return file; }
+
+     void record(const char* hook) {
+          if (!file) return;
+
+          const bool playing = aud_drct_get_playing();
+          const bool ready = playing && aud_drct_get_ready();
+          const Tuple tuple = ready ? aud_drct_get_tuple() : Tuple();
+          const long long ms
+              = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    clk::now() - start)
+                    .count();
+
+          fprintf(file, "%lld\t%s\t%d\t%d\t%d\t%d", ms, hook, playing, ready,
+                  ready && aud_drct_get_paused(),
+                  ready ? aud_drct_get_time() : 0);
+          put_field(ready ? aud_drct_get_filename() : String());
+          put_field(tuple.get_str(Tuple::Title));
+          put_field(tuple.get_str(Tuple::Artist));
+          put_field(tuple.get_str(Tuple::Album));
+          put_field(tuple.get_str(Tuple::AlbumArtist));
+          fprintf(file, "\t%d\n",
+                  tuple.get_value_type(Tuple::Length) == Tuple::Int
+                      ? tuple.get_int(Tuple::Length)
+                      : -1);
+          fflush(file);  // Keep the trace usable if Audacious crashes
+     }
+
+   private:
+     /** @brief Writes a tab-prefixed field, tabs and newlines blanked */
+     void put_field(const String& field) {
+          fputc('\t', file);
+          const char* c = field;
+          for (; c && *c; ++c)
+               fputc((*c == '\t' || *c == '\n' || *c == '\r') ? ' ' : *c, file);
+     }
+
+     FILE* file = nullptr;
+     clk::time_point start;
+};
+
+static HookRecorder recorder;
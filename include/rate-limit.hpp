@@ -0,0 +1,59 @@
+/**
+ * @file rate-limit.hpp
+ * @brief Per-upstream-host request rate limiter.
+ * @note Made for Audacious-Discord-RPC project.
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Not used by the plugin itself (one user hardly hits MusicBrainz’s
+ *       1 req/s limit), but by the tools doing lookups in bulk or for many
+ *       clients at once, which install one via fetch_limiter.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+class RateLimiter {
+   public:
+     using clk = std::chrono::steady_clock;
+
+     explicit RateLimiter(std::chrono::milliseconds interval)
+         : interval(interval) {}
+
+     /**
+      * @brief Waits for the next free slot of the host and takes it.
+      * @return false if cancelled while waiting (the slot is then wasted)
+      */
+     bool acquire(const std::string& host,
+                  const std::function<bool()>& cancelled = nullptr) {
+          clk::time_point slot;
+          {
+               std::lock_guard<std::mutex> lock(mtx);
+               auto& next = next_slot[host];
+               slot = std::max(clk::now(), next);
+               next = slot + interval;
+          }
+
+          while (clk::now() < slot) {
+               if (cancelled && cancelled()) return false;
+               std::this_thread::sleep_for(std::min<clk::duration>(
+                   slot - clk::now(), std::chrono::milliseconds(100)));
+          }
+          return true;
+     }
+
+   private:
+     const std::chrono::milliseconds interval;  //< Min. time between requests
+     std::mutex mtx;
+     std::unordered_map<std::string, clk::time_point> next_slot;
+};
@@ -0,0 +1,42 @@
+/**
+ * @file stats.hpp
+ * @brief Pipeline counters for Audacious Discord RPC.
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Cheap relaxed counters of the work done per hook, so regressions
+ *       of the whole pipeline (e.g. during a recorded session, see
+ *       hook-recorder.hpp) show up as numbers. Logged on plugin cleanup.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+
+struct RPCStats {
+     std::atomic<unsigned long long> hooks{0};             //< Hook calls
+     std::atomic<unsigned long long> threads{0};           //< Threads created
+     std::atomic<unsigned long long> fetches{0};           //< HTTP requests
+     std::atomic<unsigned long long> fetch_bytes{0};       //< HTTP bytes in
+     std::atomic<unsigned long long> presence_sends{0};    //< Sent to Discord
+     std::atomic<unsigned long long> cover_lookups{0};     //< cover_lookup()
+     std::atomic<unsigned long long> cover_tag_hits{0};    //< Hit by tags
+     std::atomic<unsigned long long> cover_art_hits{0};    //< Hit by art only
+     std::atomic<unsigned long long> cover_stale_hits{0};  //< Hit if expired
+     std::atomic<unsigned long long> revalidated{0};       //< Kept on 304
+
+     static void bump(std::atomic<unsigned long long>& counter) {
+          counter.fetch_add(1, std::memory_order_relaxed);
+     }
+
+     static void add(std::atomic<unsigned long long>& counter,
+                     unsigned long long n) {
+          counter.fetch_add(n, std::memory_order_relaxed);
+     }
+};
+
+inline RPCStats stats;  // Shared by all translation units
@@ -4,7 +4,7 @@
  * @version 2.2
  * @author onegen <onegen@onegen.dev>
  * @author Derzsi Dániel <daniel@tohka.us>
- * @date 2025-11-29 (last modified)
+ * @date 2026-10-18 (last modified)
  *
  * @license MIT
  * @copyright Copyright (c) 2024–2025 onegen
@@ -38,7 +38,7 @@ const char RPCPlugin::about[]
       " © onegen <onegen@onegen.dev> (2024–2025)\n"
       " © Derzsi Dániel <daniel@tohka.us> et al. (2018–2022)\n\n"
       "Displays the current playing track as your Discord status.\n"
-      "(Discord should be running before this plugin is loaded.)";
+      "(Connects in the background whenever Discord is running.)";
 
 static const ComboItem status_display_items[]
     = {ComboItem(N_("Music player"),
@@ -52,6 +52,10 @@ const PreferencesWidget RPCPlugin::widgets[] = {
 #if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
     WidgetCheck(N_("(UNSTABLE) Fetch album covers from MusicBrainz/CAA"),
                 WidgetBool(PLUGIN_ID, "fetch_covers")),
+    WidgetCheck(N_("Also look up album covers on iTunes"),
+                WidgetBool(PLUGIN_ID, "fetch_covers_itunes")),
+    WidgetCheck(N_("Hedge slow cover art requests"),
+                WidgetBool(PLUGIN_ID, "fetch_covers_hedge")),
 #endif
     WidgetCheck(N_("Hide presence when paused"),
                 WidgetBool(PLUGIN_ID, "hide_when_paused")),
@@ -64,6 +68,10 @@ const char *const RPCPlugin::defaults[] = {
 #if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
     "fetch_covers",
     "FALSE",
+    "fetch_covers_itunes",
+    "FALSE",
+    "fetch_covers_hedge",
+    "FALSE",
 #endif
     "hide_when_paused",
     "FALSE",
@@ -79,52 +87,307 @@ EXPORT RPCPlugin aud_plugin_instance;
 /* === Discord RPC Setup === */
 
 static discord::RPCManager &rpc = discord::RPCManager::get();
+
+/* The presence is kept up to date even while disconnected, so the latest
+ * snapshot can be replayed as soon as a connection is (re-)established. */
+static std::mutex presence_mtx;  //< Guards presence & presence_shown
 static discord::Presence presence;
+static bool presence_shown = false;  //< Snapshot is a presence, not a clear
+
+static std::thread connector;
+static std::mutex connector_mtx;  //< Guards connector_stop
+static std::condition_variable connector_cv;
+static bool connector_stop = false;
+
+static void connector_notify() {
+     { std::lock_guard<std::mutex> lock(connector_mtx); }
+     connector_cv.notify_all();
+}
+
+/**
+ * @brief Keeps (re-)connecting to Discord with exponential backoff.
+ *
+ * Runs off the main thread, so a missing Discord costs Audacious nothing.
+ * Each attempt waits up to CONNECT_TIMEOUT for the ready event; failed
+ * attempts and dropped connections are retried after a delay doubling from
+ * RECONNECT_MIN_DELAY up to RECONNECT_MAX_DELAY.
+ */
+static void connector_loop() {
+     unsigned int backoff = RECONNECT_MIN_DELAY;
+     std::unique_lock<std::mutex> lock(connector_mtx);
+     while (!connector_stop) {
+          AUDDBG("Discord RPC: Connecting...\r\n");
+          lock.unlock();
+          rpc.initialize();
+          lock.lock();
+
+          connector_cv.wait_for(
+              lock, std::chrono::milliseconds(CONNECT_TIMEOUT),
+              [] { return connector_stop || is_connected.load(); });
+          if (is_connected.load() && !connector_stop) {
+               backoff = RECONNECT_MIN_DELAY;
+               lock.unlock();
+               {
+                    std::lock_guard<std::mutex> p_lock(presence_mtx);
+                    send_presence();  // Replay the latest snapshot
+               }
+               lock.lock();
+
+               connector_cv.wait(lock, [] {
+                    return connector_stop || !is_connected.load();
+               });
+               if (connector_stop) break;  // cleanup_discord() says goodbye
+               AUDINFO("Discord RPC: Connection lost, reconnecting...\r\n");
+          }
+
+          lock.unlock();
+          rpc.shutdown();
+          lock.lock();
+
+          AUDDBG("Discord RPC: Next connection attempt in %u ms\r\n",
+                 backoff);
+          connector_cv.wait_for(lock, std::chrono::milliseconds(backoff),
+                                [] { return connector_stop; });
+          backoff = std::min(backoff * 2, RECONNECT_MAX_DELAY);
+     }
+}
 
 void init_discord() {
-     rpc.setClientID(DISCORD_APP_ID).initialize();
+     rpc.setClientID(DISCORD_APP_ID);
      rpc.onReady([](const discord::User &) {
              is_connected.store(true);
              AUDINFO("Discord RPC Connected.\r\n");
+             connector_notify();
         })
          .onDisconnected([](int, std::string_view) {
               is_connected.store(false);
               AUDINFO("Discord RPC Disconnected.\r\n");
+              connector_notify();
          })
          .onErrored([](int, std::string_view msg) {
               AUDERR("Discord RPC Error: %s\r\n", msg.data());
          });
+
+     connector_stop = false;
+     RPCStats::bump(stats.threads);
+     connector = std::thread(connector_loop);
 }
 
 void clear_discord() {
-     if (!is_connected.load()) return;
+     std::lock_guard<std::mutex> lock(presence_mtx);
      presence = discord::Presence{};  // Full reset
      presence.setLargeImageKey("logo").setLargeImageText("Audacious");
-     rpc.clearPresence();
+     presence_shown = false;
+     send_presence();
 }
 
 void cleanup_discord() {
+     {
+          std::lock_guard<std::mutex> lock(connector_mtx);
+          connector_stop = true;
+     }
+     connector_cv.notify_all();
+     if (connector.joinable()) connector.join();
+
      if (!is_connected.load()) return;
      rpc.clearPresence();
      rpc.shutdown();
+     is_connected.store(false);
+}
+
+void send_presence() {
+     if (!is_connected.load()) return;  // Replayed once connected
+     RPCStats::bump(stats.presence_sends);
+     if (presence_shown)
+          rpc.setPresence(presence).refresh();
+     else
+          rpc.clearPresence();
 }
 
 void update_presence() {
-     if (!is_connected.load()) return;
-     rpc.setPresence(presence).refresh();
+     std::lock_guard<std::mutex> lock(presence_mtx);
+     presence_shown = true;
+     send_presence();
 }
 
 void init_presence() {
-     presence = discord::Presence{};
-     presence.setLargeImageKey("logo").setLargeImageText("Audacious");
+     {
+          std::lock_guard<std::mutex> lock(presence_mtx);
+          presence = discord::Presence{};
+          presence.setLargeImageKey("logo").setLargeImageText("Audacious");
+     }
      update_presence();
 }
 
 /* === Audacious playback -> Discord RPC (main function) === */
 
-void playback_to_presence() {
-     if (!is_connected.load()) return;
+/* Per-track fields are computed once per playlist entry. Hooks that do not
+ * change the track (pause, unpause, seek) only patch the play/pause image
+ * and the timestamps. Only touched from the main (hook) thread. */
+struct TrackFields {
+     Playlist list;  //< Identity: playlist + entry + filename
+     int entry = -1;
+     String filename;
+
+     String title, artist, album;  //< Sanitised
+     String cover_artist;          //< Album artist, or artist as fallback
+     bool has_album = false;
+     bool has_length = false;
+     int length_s = 0;
+
+     bool is_stream = false;  //< Internet radio (no length, not a file)
+     String raw_title;        //< Stream title as received (ICY metadata)
+};
+static std::optional<TrackFields> track;
+
+/* Large image key (cover URL or "logo") of the current track.
+ * Guarded by presence_mtx, as it is set by the cover fetching thread. */
+static std::string large_image_key = "logo";
+
+static bool is_patch_hook(const char *hook) {
+     return hook
+            && (!strcmp(hook, "playback pause")
+                || !strcmp(hook, "playback unpause")
+                || !strcmp(hook, "playback seek"));
+}
+
+static bool is_current_track(const TrackFields &t) {
+     Playlist list = Playlist::playing_playlist();
+     return t.list == list && t.entry == list.get_position()
+            && !strcmp_safe(t.filename, aud_drct_get_filename());
+}
+
+/** @brief Reads the tuple into the per-track fields; false if untitled */
+static bool read_track() {
+     const Tuple tuple = aud_drct_get_tuple();
+     TrackFields t;
+     t.list = Playlist::playing_playlist();
+     t.entry = t.list.get_position();
+     t.filename = aud_drct_get_filename();
+
+     t.title = tuple.get_str(Tuple::Title);
+     if (audstr_empty(t.title)) {
+          // Fallback to filename
+          t.title = tuple.get_str(Tuple::Basename);
+          if (audstr_empty(t.title)) return false;
+     }
+
+     t.has_length = tuple.get_value_type(Tuple::Length) == Tuple::Int;
+     t.length_s = t.has_length ? tuple.get_int(Tuple::Length) / 1000 : 0;
+     t.is_stream = t.length_s <= 0 && strncmp(t.filename, "file://", 7);
+     t.raw_title = t.title;
+
+     String artist = tuple.get_str(Tuple::Artist);
+     if (t.is_stream && audstr_empty(artist)) {
+          // ICY stream titles are usually "Artist - Title"
+          const char *raw = t.raw_title;
+          const char *sep = strstr(raw, " - ");
+          if (sep && sep != raw && *(sep + 3)) {
+               artist = String(str_copy(raw, sep - raw));
+               t.title = String(sep + 3);
+          }
+     }
+
+     String album = tuple.get_str(Tuple::Album);
+     String album_artist = tuple.get_str(Tuple::AlbumArtist);
+     t.title = field_sanitise(t.title);
+     t.artist = field_sanitise(artist);
+     t.has_album = !audstr_empty(album);
+     t.album = t.has_album ? field_sanitise(album) : String("");
+     t.cover_artist = audstr_empty(album_artist) ? t.artist : album_artist;
+
+     track = std::move(t);
+     return true;
+}
+
+/* Streams fire "title change" on every ICY metadata update, which often
+ * repeats the current song. Per station (keyed by stream URL), identical
+ * metadata is dropped and changes are sent at most every STREAM_MIN_UPDATE,
+ * the latest one winning. Cover lookups are limited to one per station
+ * every STREAM_COVER_INTERVAL; in between, the station's last cover is
+ * shown. */
+static String stream_station, stream_title;  //< Last sent
+static rpc_clock::time_point stream_sent;
+static QueuedFunc stream_trailing;  //< Deferred update of a throttled title
+static std::unordered_map<std::string, rpc_clock::time_point> stream_lookups;
+static std::unordered_map<std::string, std::string>
+    stream_covers;  //< Last cover per station; guarded by presence_mtx
+
+static void stream_reset() {
+     stream_trailing.stop();
+     stream_station = String();
+     stream_title = String();
+}
+
+/** @brief True if the (stream) track should not be sent (yet) */
+static bool stream_throttled() {
+     using clk = rpc_clock;
+     const bool same_station = !strcmp_safe(stream_station, track->filename);
+     if (same_station && !strcmp_safe(stream_title, track->raw_title)) {
+          AUDDBG("Discord RPC: Repeated stream metadata, ignoring.\r\n");
+          return true;
+     }
+
+     const auto since = std::chrono::duration_cast<std::chrono::milliseconds>(
+         clk::now() - stream_sent);
+     if (same_station && since.count() < STREAM_MIN_UPDATE) {
+          if (!stream_trailing.running())
+               stream_trailing.queue(
+                   STREAM_MIN_UPDATE - since.count(),
+                   [](void *) { playback_to_presence(nullptr); }, nullptr);
+          return true;
+     }
+
+     stream_trailing.stop();
+     stream_station = track->filename;
+     stream_title = track->raw_title;
+     stream_sent = clk::now();
+     return false;
+}
+
+static bool stream_lookup_allowed() {
+     using clk = rpc_clock;
+     const auto now = clk::now();
+     auto [it, fresh] = stream_lookups.try_emplace(
+         (const char *)track->filename, now);
+     if (fresh) return true;
+     if (now - it->second < std::chrono::milliseconds(STREAM_COVER_INTERVAL))
+          return false;
+     it->second = now;
+     return true;
+}
+
+/** @brief Sets the timestamps; expects presence_mtx to be held */
+static void set_timestamps(bool playing) {
+     if (!playing || !track->has_length) {
+          presence.setStartTimestamp(0).setEndTimestamp(0);
+          return;
+     }
+
+     const auto now = std::chrono::system_clock::now();
+     const auto start_time
+         = now - std::chrono::seconds(aud_drct_get_time() / 1000);
+     presence.setStartTimestamp(
+         std::chrono::duration_cast<std::chrono::seconds>(
+             start_time.time_since_epoch())
+             .count());
+
+     if (track->length_s > 0) {
+          const auto end_time
+              = start_time + std::chrono::seconds(track->length_s);
+          presence.setEndTimestamp(
+              std::chrono::duration_cast<std::chrono::seconds>(
+                  end_time.time_since_epoch())
+                  .count());
+     } else {
+          presence.setEndTimestamp(0);
+     }
+}
+
+void playback_to_presence(const char *hook) {
      if (!aud_drct_get_playing() || !aud_drct_get_ready()) {
+          track.reset();
+          stream_reset();
           clear_discord();
           return;
      }
@@ -135,90 +398,101 @@ void playback_to_presence() {
           return;
      }
 
-     AUDDBG("Discord RPC: playback_to_presence called\r\n");
-     const Tuple tuple = aud_drct_get_tuple();
-     String title = tuple.get_str(Tuple::Title);
-     String artist = tuple.get_str(Tuple::Artist);
-     String album = tuple.get_str(Tuple::Album);
-     if (audstr_empty(title)) {
-          // Fallback to filename
-          title = tuple.get_str(Tuple::Basename);
-          if (audstr_empty(title)) {
-               // Give up
-               AUDINFO("Discord RPC: No title or filename, giving up.\r\n");
-               clear_discord();
-               return;
-          }
+     AUDDBG("Discord RPC: playback_to_presence called (%s)\r\n",
+            hook ? hook : "no hook");
+     const bool new_track
+         = !(is_patch_hook(hook) && track && is_current_track(*track));
+     if (new_track && !read_track()) {
+          // Give up
+          AUDINFO("Discord RPC: No title or filename, giving up.\r\n");
+          track.reset();
+          stream_reset();
+          clear_discord();
+          return;
      }
-
-     title = field_sanitise(title);
-     artist = field_sanitise(artist);
-     bool has_album = !audstr_empty(album);
-     album = has_album ? field_sanitise(album) : String("");
+     if (new_track && track->is_stream && stream_throttled()) return;
+     if (new_track && !track->is_stream)
+          stream_reset();  // Back on the station later, its title is news
 
      int status_display_type = aud_get_int(PLUGIN_ID, "status_display_type");
 
-     presence.setLargeImageKey("logo")
-         .setActivityType(discord::ActivityType::Listening)
+     /* Every new track outdates the cover task of the last one, whether or
+      * not it gets one of its own */
+     const unsigned long long req_id = new_track ? ++req_id_now : 0;
+     const bool fetch_cover = new_track && track->has_album
+                              && aud_get_bool(PLUGIN_ID, "fetch_covers")
+                              && (!track->is_stream || stream_lookup_allowed());
+
+     std::unique_lock<std::mutex> lock(presence_mtx);
+     if (new_track) {
+          large_image_key = "logo";
+          auto it = stream_covers.find((const char *)track->filename);
+          if (track->is_stream && !fetch_cover && it != stream_covers.end())
+               large_image_key = it->second;
+     }
+     if (new_track || !presence_shown) {
+          // (Re)build the whole presence, cleared ones included
+          presence.setLargeImageKey(large_image_key)
+              .setActivityType(discord::ActivityType::Listening)
+              .setDetails((const char *)track->title)
+              .setState((const char *)track->artist)
+              .setLargeImageText((const char *)track->album)
+              .setSmallImageText("Audacious");
+     }
+
+     presence
          .setStatusDisplayType(
              static_cast<discord::StatusDisplayType>(status_display_type))
-         .setDetails((const char *)title)
-         .setState((const char *)artist)
-         .setLargeImageText((const char *)album)
-         .setSmallImageKey(playing ? "play" : "pause")
-         .setSmallImageText("Audacious");
-
-     if (playing && tuple.get_value_type(Tuple::Length) == Tuple::Int) {
-          const auto now = std::chrono::system_clock::now();
-          const auto start_time
-              = now - std::chrono::seconds(aud_drct_get_time() / 1000);
-          presence.setStartTimestamp(
-              std::chrono::duration_cast<std::chrono::seconds>(
-                  start_time.time_since_epoch())
-                  .count());
+         .setSmallImageKey(playing ? "play" : "pause");
+     set_timestamps(playing);
 
-          int length_s = tuple.get_int(Tuple::Length) / 1000;
-          if (length_s > 0) {
-               const auto end_time
-                   = start_time + std::chrono::seconds(length_s);
-               presence.setEndTimestamp(
-                   std::chrono::duration_cast<std::chrono::seconds>(
-                       end_time.time_since_epoch())
-                       .count());
-          } else {
-               presence.setEndTimestamp(0);
-          }
-     } else {
-          presence.setStartTimestamp(0).setEndTimestamp(0);
-     }
-
-     update_presence();
+     presence_shown = true;
+     send_presence();
+     lock.unlock();
      AUDINFO("Discord RPC: playback_to_presence successfully updated RPC!\r\n");
 
-     if (has_album && aud_get_bool(PLUGIN_ID, "fetch_covers")) {
-          String album_artist = tuple.get_str(Tuple::AlbumArtist);
-          bool has_album_artist = !audstr_empty(album_artist);
-
+     if (fetch_cover) {
           AUDINFO("Discord RPC: Starting a cover art fetching task\r\n");
-          cover_to_presence(has_album_artist ? album_artist : artist, album);
+          cover_to_presence(track->cover_artist, track->album,
+                            track->filename, track->is_stream, req_id);
      }
 }
 
 /* == Attempt to fetch cover art, if enabled */
 
-void cover_to_presence(const String &artist, const String &album) {
+void cover_to_presence(const String &artist, const String &album,
+                       const String &filename, bool is_stream,
+                       unsigned long long req_id) {
 #if (defined(DISABLE_RPC_CAF) && DISABLE_RPC_CAF)
      return;
 #else
-     unsigned long long req_id = ++req_id_now;
-     std::thread([req_id, artist, album] {
+     itunes_provider.enabled.store(
+         aud_get_bool(PLUGIN_ID, "fetch_covers_itunes"));
+     fetch_hedging.store(aud_get_bool(PLUGIN_ID, "fetch_covers_hedge"));
+
+     /* Fingerprint of the embedded cover, if Audacious has it loaded
+      * already (it usually has, for its own UI), as a secondary cache key
+      * for tracks whose tags differ but whose art does not. */
+     std::uint64_t art_hash = 0;
+     bool art_queued = false;
+     AudArtPtr art = aud_art_request(filename, AUD_ART_DATA, &art_queued);
+     const Index<char> *art_data = art.data();
+     if (art_data && art_data->len() > 0)
+          art_hash = art_fingerprint(art_data->begin(), art_data->len());
+
+     std::string station = is_stream ? (const char *)filename : "";
+     RPCStats::bump(stats.threads);
+     std::thread([req_id, artist, album, art_hash, station] {
           if (req_id != req_id_now.load(std::memory_order_relaxed)) return;
           auto url = cover_lookup((const char *)artist, (const char *)album,
-                                  &req_id_now, req_id);
+                                  &req_id_now, req_id, art_hash);
           if (url && !url->empty()
               && req_id == req_id_now.load(std::memory_order_relaxed)) {
-               presence.setLargeImageKey(*url);
-               update_presence();
+               std::lock_guard<std::mutex> lock(presence_mtx);
+               large_image_key = *url;
+               if (!station.empty()) stream_covers[station] = *url;
+               presence.setLargeImageKey(large_image_key);
+               send_presence();
                AUDINFO("Discord RPC: Cover fetch task %llu applied!\r\n",
                        req_id);
           } else {
@@ -229,27 +503,78 @@ void cover_to_presence(const String &artist, const String &album) {
 #endif
 }
 
+/* === Persistent cover cache === */
+
+#if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
+static std::thread cache_loader;  //< Loads off the main thread
+
+static std::string cover_cache_path() {
+     return std::string(aud_get_path(AudPath::UserDir)) + "/" COVER_CACHE_FILE;
+}
+
+static void load_cover_cache() {
+     std::string path = cover_cache_path();
+     RPCStats::bump(stats.threads);
+     cache_loader = std::thread([path] {
+          AUDINFO("Discord RPC: Loaded %zu cached covers\r\n",
+                  cache.load(path));
+     });
+}
+
+static void save_cover_cache() {
+     if (cache_loader.joinable()) cache_loader.join();
+     if (!cache.save(cover_cache_path(), true))
+          AUDERR("Discord RPC: Cannot save the cover cache\r\n");
+}
+#endif
+
 /* === Hook RPC to Audacious === */
 
+static const char *const hooks[]
+    = {"playback ready",   "playback end",  "playback stop", "playback pause",
+       "playback unpause", "playback seek", "title change"};
+
 bool RPCPlugin::init() {
      aud_config_set_defaults(PLUGIN_ID, defaults);
      init_discord();
      init_presence();
-     hook_associate("playback ready", on_playback_update_rpc, nullptr);
-     hook_associate("playback end", on_playback_update_rpc, nullptr);
-     hook_associate("playback stop", on_playback_update_rpc, nullptr);
-     hook_associate("playback pause", on_playback_update_rpc, nullptr);
-     hook_associate("playback unpause", on_playback_update_rpc, nullptr);
-     hook_associate("title change", on_playback_update_rpc, nullptr);
+#if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
+     load_cover_cache();
+#endif
+
+     const char *record_path = getenv(RECORD_ENV);
+     if (record_path && *record_path) {
+          if (recorder.open(record_path))
+               AUDINFO("Discord RPC: Recording hooks to %s\r\n", record_path);
+          else
+               AUDERR("Discord RPC: Cannot record hooks to %s\r\n",
+                      record_path);
+     }
+
+     // Hook name is passed as user data (for the recorder)
+     for (const char *hook : hooks)
+          hook_associate(hook, on_playback_update_rpc,
+                         const_cast<char *>(hook));
      return true;
 }
 
 void RPCPlugin::cleanup() {
-     hook_dissociate("playback ready", on_playback_update_rpc);
-     hook_dissociate("playback end", on_playback_update_rpc);
-     hook_dissociate("playback stop", on_playback_update_rpc);
-     hook_dissociate("playback pause", on_playback_update_rpc);
-     hook_dissociate("playback unpause", on_playback_update_rpc);
-     hook_dissociate("title change", on_playback_update_rpc);
+     for (const char *hook : hooks)
+          hook_dissociate(hook, on_playback_update_rpc);
+     stream_reset();
      cleanup_discord();
+     recorder.close();
+#if (!(defined(DISABLE_RPC_CAF)) && !(DISABLE_RPC_CAF))
+     save_cover_cache();
+#endif
+
+     AUDINFO(
+         "Discord RPC: %llu hooks, %llu threads, %llu fetches (%llu B), %llu "
+         "presence sends, %llu cover lookups (%llu tag hits, %llu art hits, "
+         "%llu stale hits, %llu revalidated)\r\n",
+         stats.hooks.load(), stats.threads.load(), stats.fetches.load(),
+         stats.fetch_bytes.load(), stats.presence_sends.load(),
+         stats.cover_lookups.load(), stats.cover_tag_hits.load(),
+         stats.cover_art_hits.load(), stats.cover_stale_hits.load(),
+         stats.revalidated.load());
 }
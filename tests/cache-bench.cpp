@@ -0,0 +1,86 @@
+/**
+ * @file cache-bench.cpp
+ * @brief Throughput benchmark of the cover art cache
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Lookups of a warmed cache the size the plugin uses (6000 albums,
+ *       90 % of them cached with CAA URLs and ETags, misses filled with
+ *       iTunes URLs), like a long listening session over a large library.
+ *       With `-t N`, N threads split the rounds among them and share the
+ *       cache, to see how the sharded locks scale.
+ *
+ * @code{.sh}
+ * bench-cache [-t THREADS] [-r ROUNDS]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "covers-cache.hpp"
+
+using clk = std::chrono::steady_clock;
+
+constexpr unsigned N_ALBUMS = 6000;
+
+int main(int argc, char** argv) {
+     unsigned n_threads = 1, rounds = 200;
+     for (int i = 1; i + 1 < argc; i += 2) {
+          if (!std::strcmp(argv[i], "-t"))
+               n_threads = std::max(1, std::atoi(argv[i + 1]));
+          else if (!std::strcmp(argv[i], "-r"))
+               rounds = std::max(1, std::atoi(argv[i + 1]));
+     }
+
+     CoverArtCache cache(8192, 1 << 20, std::chrono::seconds(3600),
+                         std::chrono::seconds(30 * 24 * 3600));
+     std::vector<std::pair<std::string, std::string>> keys;
+     for (unsigned i = 0; i < N_ALBUMS; ++i) {
+          char url[96], etag[16];
+          std::snprintf(etag, sizeof etag, "\"%u\"", i);
+          std::snprintf(url, sizeof url,
+                        "https://coverartarchive.org/release/"
+                        "%08x-1c2d-4e5f-8a9b-%012x/%llu-500.jpg",
+                        i * 2654435761u, i, 30000000000ull + i);
+          keys.emplace_back("Artist " + std::to_string(i % 700),
+                            "Album " + std::to_string(i));
+          if (i % 10)
+               cache.put(keys.back().first, keys.back().second, url,
+                         {etag, ""});
+     }
+
+     auto run = [&](unsigned first_round, unsigned step) {
+          for (unsigned r = first_round; r < rounds; r += step)
+               for (std::size_t i = 0; i < keys.size(); ++i) {
+                    auto& [artist, album] = keys[(i * 7919 + r) % keys.size()];
+                    if (!cache.get(artist, album))
+                         cache.put(artist, album,
+                                   "https://is1-ssl.mzstatic.com/image/thumb/"
+                                   "x/512x512bb.jpg");
+               }
+     };
+
+     auto t0 = clk::now();
+     std::vector<std::thread> threads;
+     for (unsigned t = 0; t < n_threads; ++t)
+          threads.emplace_back(run, t, n_threads);
+     for (auto& thread : threads) thread.join();
+     double secs = std::chrono::duration<double>(clk::now() - t0).count();
+
+     double n_ops = double(rounds) * keys.size();
+     std::printf("%u threads: %.1f ns/op, %.2f M ops/s\n", n_threads,
+                 secs * 1e9 / n_ops, n_ops / secs / 1e6);
+     return 0;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file cache-stress.cpp
+ * @brief Concurrency stress test of the cover art cache
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Meant to be built with `-fsanitize=thread` (see CMakeLists.txt).
+ *       For 1 to 16 threads, hammers one small cache with a mix of hits,
+ *       misses, puts, stale reads, clears and save/load round trips, with
+ *       a TTL short enough for entries to expire and be dropped meanwhile.
+ *       Every value read back must belong to the key it was read from.
+ *       Then checks that a merging save keeps what another process wrote.
+ *
+ * @code{.sh}
+ * test-cache-stress [-d MS_PER_ROUND] [THREADS...]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "covers-cache.hpp"
+
+using clk = std::chrono::steady_clock;
+
+constexpr unsigned N_KEYS = 2048;  // ~4x the capacity, so puts also evict
+
+static std::atomic<unsigned long> n_errors{0};
+
+static std::string artist_of(unsigned i) {
+     return "Artist " + std::to_string(i % 97);
+}
+
+static std::string album_of(unsigned i) { return "Album " + std::to_string(i); }
+
+/* Even keys get CAA URLs (compact values), odd ones raw URLs */
+static std::string url_prefix(unsigned i) {
+     char buf[80];
+     if (i % 2 == 0)
+          std::snprintf(buf, sizeof buf,
+                        "https://coverartarchive.org/release/"
+                        "%08x-0000-4000-8000-000000000000/",
+                        i);
+     else
+          std::snprintf(buf, sizeof buf, "https://example.org/%u/", i);
+     return buf;
+}
+
+static std::string url_of(unsigned i, unsigned version) {
+     return url_prefix(i) + std::to_string(version)
+            + (i % 2 == 0 ? "-500.jpg" : ".jpg");
+}
+
+static std::string etag_prefix(unsigned i) {
+     return "\"" + std::to_string(i) + "-";
+}
+
+static void check(bool ok, const char* what, unsigned i) {
+     if (ok) return;
+     if (n_errors.fetch_add(1) < 10)
+          std::fprintf(stderr, "key %u: %s does not belong to it\n", i, what);
+}
+
+static void worker(CoverArtCache& cache, unsigned seed, bool saver,
+                   const std::string& path, clk::time_point deadline,
+                   std::atomic<unsigned long>& n_ops) {
+     std::mt19937 rng(seed);
+     unsigned long ops = 0;
+     unsigned version = 0;
+
+     while (clk::now() < deadline) {
+          unsigned i = rng() % N_KEYS;
+          unsigned op = rng() % 1000;
+          std::string artist = artist_of(i), album = album_of(i);
+
+          if (op < 700) {
+               if (auto url = cache.get(artist, album))
+                    check(url->starts_with(url_prefix(i)), "URL", i);
+          } else if (op < 800) {
+               if (auto entry = cache.get_stale(artist, album)) {
+                    check(entry->url.starts_with(url_prefix(i)), "stale URL",
+                          i);
+                    check(entry->validators.empty()
+                              || entry->validators.etag.starts_with(
+                                  etag_prefix(i))
+                              || !entry->validators.last_modified.empty(),
+                          "ETag", i);
+                    check(entry->release.has_value() == (i % 2 == 0),
+                          "release", i);
+               }
+          } else if (op < 900) {
+               cache.put(artist, album, url_of(i, ++version));
+          } else if (op < 998) {
+               CoverValidators v;
+               if (rng() % 2)
+                    v.etag = etag_prefix(i) + std::to_string(version) + "\"";
+               else
+                    v.last_modified = "Sat, 18 Oct 2026 12:00:00 GMT";
+               cache.put(artist, album, url_of(i, ++version), v);
+          } else if (op < 999 || !saver) {
+               cache.clear();
+          } else {
+               // Round trip through the cache file while others keep going
+               cache.save(path, rng() % 2);
+               cache.load(path);
+          }
+          ++ops;
+     }
+     n_ops += ops;
+}
+
+/* The warmer wrote one cover we do not have and a newer one of ours */
+static void check_merge(const std::string& path) {
+     const long long now = std::chrono::system_clock::to_time_t(
+         std::chrono::system_clock::now());
+     {
+          std::ofstream file(path, std::ios::trunc);
+          file << now << "\tArtist\tWarmed\t" << url_of(0, 1) << '\n'
+               << now + 60 << "\tArtist\tBoth\t" << url_of(1, 2) << '\n';
+     }
+
+     CoverArtCache ours(64, 64 * 1024, std::chrono::seconds(3600),
+                        std::chrono::seconds(3600));
+     ours.put("Artist", "Ours", url_of(2, 1));
+     ours.put("Artist", "Both", url_of(1, 1));
+     ours.save(path, true);
+
+     CoverArtCache merged(64, 64 * 1024, std::chrono::seconds(3600),
+                          std::chrono::seconds(3600));
+     merged.load(path);
+     check(merged.get("Artist", "Warmed") == url_of(0, 1), "merged URL", 0);
+     check(merged.get("Artist", "Both") == url_of(1, 2), "merged URL", 1);
+     check(merged.get("Artist", "Ours") == url_of(2, 1), "merged URL", 2);
+}
+
+int main(int argc, char** argv) {
+     long round_ms = 1500;
+     std::vector<unsigned> thread_counts;
+     for (int i = 1; i < argc; ++i) {
+          if (!std::strcmp(argv[i], "-d") && i + 1 < argc)
+               round_ms = std::atol(argv[++i]);
+          else if (unsigned n = std::atoi(argv[i]); n > 0)
+               thread_counts.push_back(n);
+     }
+     if (thread_counts.empty()) thread_counts = {1, 2, 4, 8, 16};
+
+     const std::string path
+         = (std::filesystem::temp_directory_path()
+            / ("discord-rpc-cache-stress-" + std::to_string(::getpid())))
+               .string();
+
+     for (unsigned n_threads : thread_counts) {
+          // 1 s TTL + 1 s stale window => expiry and drops happen mid-round
+          CoverArtCache cache(512, 64 * 1024, std::chrono::seconds(1),
+                              std::chrono::seconds(1));
+          std::atomic<unsigned long> n_ops{0};
+          auto deadline = clk::now() + std::chrono::milliseconds(round_ms);
+
+          std::vector<std::thread> threads;
+          for (unsigned t = 0; t < n_threads; ++t)
+               threads.emplace_back(worker, std::ref(cache), t + 1, t == 0,
+                                    std::cref(path), deadline,
+                                    std::ref(n_ops));
+          for (auto& thread : threads) thread.join();
+
+          std::printf("%2u threads: %10.0f ops/s\n", n_threads,
+                      n_ops * 1000.0 / round_ms);
+     }
+
+     check_merge(path);
+     std::filesystem::remove(path);
+     if (n_errors) {
+          std::fprintf(stderr, "%lu mismatched reads\n", n_errors.load());
+          return 1;
+     }
+     return 0;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file cover-race.cpp
+ * @brief Tests and latency benchmark of the cover provider race
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Races stub providers with fixed or heavy-tailed (Pareto) delays
+ *       instead of real ones, so no network is involved. Checks that the
+ *       first acceptable result wins and the other providers are cancelled,
+ *       that low scores, late results and superseded lookups are handled,
+ *       then compares p50/p99 lookup latency of one provider against a race
+ *       of two with the same delay distribution.
+ *
+ * @code{.sh}
+ * test-cover-race [-n LOOKUPS]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "covers.hpp"
+
+using clk = std::chrono::steady_clock;
+using ms = std::chrono::milliseconds;
+
+static int n_failed = 0;
+
+#define CHECK(cond)                                                        \
+     do {                                                                  \
+          if (!(cond)) {                                                   \
+               std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, \
+                            __LINE__, #cond);                              \
+               ++n_failed;                                                 \
+          }                                                                \
+     } while (0)
+
+/** @brief Provider that answers after a delay, unless cancelled first */
+class StubProvider : public CoverProvider {
+   public:
+     /* delay_ms = 0 => drawn from a Pareto distribution (x_m = 5 ms) */
+     StubProvider(const char* url, unsigned int score, unsigned int delay_ms,
+                  unsigned int seed = 1, unsigned int min_score = 50,
+                  ms timeout = ms(2000))
+         : CoverProvider(min_score, timeout, true),
+           url(url),
+           score(score),
+           delay_ms(delay_ms),
+           rng(seed) {}
+
+     const char* name() const override { return url; }
+
+     std::optional<CoverResult> lookup(
+         const std::string&, const std::string&,
+         const LookupToken& token) const override {
+          running.fetch_add(1);
+          const auto start = clk::now();
+          const auto until = start + delay();
+          std::optional<CoverResult> res;
+          while (clk::now() < until && !token.cancelled())
+               std::this_thread::sleep_for(ms(1));
+          if (token.cancelled()) {
+               // Time from the start until the stub gave up
+               cancelled_after.store(
+                   std::chrono::duration_cast<ms>(clk::now() - start).count());
+          } else {
+               res = CoverResult{url, score, {}};
+          }
+          running.fetch_sub(1);
+          return res;
+     }
+
+     /** @brief Waits until no lookup of this provider runs anymore */
+     void drain() const {
+          while (running.load()) std::this_thread::sleep_for(ms(1));
+     }
+
+     const char* url;
+     const unsigned int score;
+     const unsigned int delay_ms;
+     mutable std::atomic<int> running{0};
+     mutable std::atomic<long long> cancelled_after{-1};
+
+   private:
+     clk::duration delay() const {
+          if (delay_ms) return ms(delay_ms);
+          std::lock_guard<std::mutex> lock(rng_mtx);
+          // Pareto (alpha = 1.2), capped below the provider timeout
+          double u = std::uniform_real_distribution<double>(1e-9, 1.0)(rng);
+          double d = 5.0 / std::pow(u, 1.0 / 1.2);
+          return std::chrono::duration_cast<clk::duration>(
+              std::chrono::duration<double, std::milli>(std::min(d, 1500.0)));
+     }
+
+     mutable std::mt19937 rng;
+     mutable std::mutex rng_mtx;
+};
+
+static long long since(clk::time_point start) {
+     return std::chrono::duration_cast<ms>(clk::now() - start).count();
+}
+
+/* === Tests === */
+
+static void test_first_acceptable_wins() {
+     StubProvider fast("fast", 90, 30), slow("slow", 95, 800);
+     CoverProvider* const providers[] = {&slow, &fast};
+
+     auto start = clk::now();
+     auto res = cover_race("A", "B", nullptr, 0, providers);
+     long long took = since(start);
+
+     CHECK(res && res->url == std::string("fast"));
+     CHECK(took < 200);
+     slow.drain();
+     // Cancelled right after the race was decided, not left running
+     CHECK(slow.cancelled_after.load() >= 0);
+     CHECK(slow.cancelled_after.load() < 200);
+     fast.drain();
+}
+
+static void test_low_score_rejected() {
+     StubProvider bad("bad", 10, 20), good("good", 80, 100);
+     CoverProvider* const providers[] = {&bad, &good};
+
+     auto res = cover_race("A", "B", nullptr, 0, providers);
+     CHECK(res && res->url == std::string("good"));
+     bad.drain();
+     good.drain();
+}
+
+static void test_late_result_ignored() {
+     StubProvider late("late", 90, 600, 1, 50, ms(200));
+     CoverProvider* const providers[] = {&late};
+
+     auto start = clk::now();
+     auto res = cover_race("A", "B", nullptr, 0, providers);
+     long long took = since(start);
+
+     CHECK(!res);
+     CHECK(took >= 200 && took < 400);
+     late.drain();
+     CHECK(late.cancelled_after.load() >= 0);
+}
+
+static void test_superseded_lookup() {
+     StubProvider a("a", 90, 1000), b("b", 90, 1000);
+     CoverProvider* const providers[] = {&a, &b};
+     std::atomic<unsigned long long> active_req_id{1};
+
+     std::thread skip([&] {
+          std::this_thread::sleep_for(ms(50));
+          active_req_id.store(2);  // User skipped to the next track
+     });
+     auto start = clk::now();
+     auto res = cover_race("A", "B", &active_req_id, 1, providers);
+     long long took = since(start);
+     skip.join();
+
+     CHECK(!res);
+     CHECK(took < 300);
+     a.drain();
+     b.drain();
+     CHECK(a.cancelled_after.load() >= 0 && b.cancelled_after.load() >= 0);
+}
+
+static void test_disabled_skipped() {
+     StubProvider off("off", 100, 10), on("on", 60, 50);
+     off.enabled.store(false);
+     CoverProvider* const providers[] = {&off, &on};
+
+     auto res = cover_race("A", "B", nullptr, 0, providers);
+     CHECK(res && res->url == std::string("on"));
+     CHECK(off.cancelled_after.load() == -1);  // Never ran
+     on.drain();
+}
+
+/* === Benchmark === */
+
+static std::vector<long long> lookup_latencies(
+    std::span<CoverProvider* const> providers, int n) {
+     std::vector<long long> us;
+     for (int i = 0; i < n; ++i) {
+          auto start = clk::now();
+          cover_race("A", "B", nullptr, 0, providers);
+          us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                           clk::now() - start)
+                           .count());
+     }
+     std::sort(us.begin(), us.end());
+     return us;
+}
+
+static double pct(const std::vector<long long>& sorted_us, double p) {
+     auto i = static_cast<std::size_t>(p * (sorted_us.size() - 1));
+     return sorted_us[i] / 1000.0;
+}
+
+int main(int argc, char** argv) {
+     int n = 300;
+     for (int i = 1; i + 1 < argc; ++i)
+          if (!std::strcmp(argv[i], "-n"))
+               n = std::max(1, std::atoi(argv[++i]));
+
+     test_first_acceptable_wins();
+     test_low_score_rejected();
+     test_late_result_ignored();
+     test_superseded_lookup();
+     test_disabled_skipped();
+
+     // Same heavy-tailed delays, independent draws per provider
+     StubProvider a("a", 90, 0, 1), b("b", 90, 0, 2);
+     CoverProvider* const single[] = {&a};
+     CoverProvider* const race[] = {&a, &b};
+     auto single_us = lookup_latencies(single, n);
+     auto race_us = lookup_latencies(race, n);
+     a.drain();
+     b.drain();
+
+     std::printf("%d lookups, Pareto delays (x_m = 5 ms, alpha = 1.2)\n", n);
+     std::printf("  single provider: p50 %7.1f ms, p99 %7.1f ms\n",
+                 pct(single_us, 0.50), pct(single_us, 0.99));
+     std::printf("  race of two:     p50 %7.1f ms, p99 %7.1f ms\n",
+                 pct(race_us, 0.50), pct(race_us, 0.99));
+     CHECK(pct(race_us, 0.99) < pct(single_us, 0.99));
+
+     if (n_failed) std::fprintf(stderr, "%d checks failed\n", n_failed);
+     return n_failed ? 1 : 0;
+}
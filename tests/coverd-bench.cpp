@@ -0,0 +1,195 @@
+/**
+ * @file coverd-bench.cpp
+ * @brief Throughput benchmark of the cover daemon under concurrent clients
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Starts the daemon (built against the stand-in upstreams of the
+ *       replay runner, so no network is used) and lets many clients look
+ *       up covers at once, mostly of the same few popular albums, like
+ *       players on one host starting the same playlist. Reports lookups
+ *       per second and latencies, and checks that the daemon resolved
+ *       every album upstream only once, however many clients asked for it
+ *       at the same time.
+ *
+ * @code{.sh}
+ * bench-coverd DAEMON [-c CLIENTS] [-n LOOKUPS] [-a ALBUMS] [-l LATENCY_MS]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "coverd.hpp"
+
+using clk = std::chrono::steady_clock;
+
+static int n_failed = 0;
+
+#define CHECK(cond)                                                        \
+     do {                                                                  \
+          if (!(cond)) {                                                   \
+               std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, \
+                            __LINE__, #cond);                              \
+               ++n_failed;                                                 \
+          }                                                                \
+     } while (0)
+
+static double pct(std::vector<double> lat, double p) {
+     if (lat.empty()) return 0;
+     std::sort(lat.begin(), lat.end());
+     return lat[static_cast<std::size_t>(p * (lat.size() - 1))];
+}
+
+int main(int argc, char** argv) {
+     if (argc < 2) {
+          std::fprintf(stderr,
+                       "Usage: %s DAEMON [-c CLIENTS] [-n LOOKUPS] [-a ALBUMS] "
+                       "[-l LATENCY_MS]\n",
+                       argv[0]);
+          return 2;
+     }
+     const char* daemon = argv[1];
+     unsigned clients = 48, lookups = 50, albums = 100, latency = 50;
+     for (int i = 2; i + 1 < argc; i += 2) {
+          if (!std::strcmp(argv[i], "-c"))
+               clients = std::atoi(argv[i + 1]);
+          else if (!std::strcmp(argv[i], "-n"))
+               lookups = std::atoi(argv[i + 1]);
+          else if (!std::strcmp(argv[i], "-a"))
+               albums = std::max(1, std::atoi(argv[i + 1]));
+          else if (!std::strcmp(argv[i], "-l"))
+               latency = std::atoi(argv[i + 1]);
+     }
+
+     char dir[] = "/tmp/bench-coverd-XXXXXX";
+     if (!mkdtemp(dir)) {
+          std::perror("mkdtemp");
+          return 2;
+     }
+     const std::string socket_path = std::string(dir) + "/coverd.sock";
+
+     // Daemon, its stderr piped here for its closing counters
+     int err_pipe[2];
+     if (pipe(err_pipe) < 0) return 2;
+     pid_t pid = fork();
+     if (pid == 0) {
+          dup2(err_pipe[1], STDERR_FILENO);
+          close(err_pipe[0]);
+          setenv("DISCORD_RPC_REPLAY_LATENCY", std::to_string(latency).c_str(),
+                 1);
+          execl(daemon, daemon, "--socket", socket_path.c_str(), "--interval",
+                "0", static_cast<char*>(nullptr));
+          std::perror("exec");
+          _exit(127);
+     }
+     close(err_pipe[1]);
+
+     struct stat st;
+     for (int i = 0; i < 500 && lstat(socket_path.c_str(), &st) < 0; ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+     setenv(COVERD_SOCKET_ENV, socket_path.c_str(), 1);
+
+     // Clients start together; popular albums are asked for far more often
+     std::atomic<bool> go{false};
+     std::mutex results_mtx;
+     std::vector<double> lat;
+     std::set<unsigned> hit_albums;
+     unsigned hits = 0, misses = 0, unavailable = 0;
+     std::vector<std::thread> threads;
+     for (unsigned c = 0; c < clients; ++c) {
+          threads.emplace_back([&, c] {
+               std::mt19937 rng(c + 1);
+               std::uniform_real_distribution<double> u(0, 1);
+               std::vector<double> my_lat;
+               std::set<unsigned> my_hits;
+               unsigned my_counts[3] = {};
+               while (!go.load()) std::this_thread::yield();
+
+               for (unsigned i = 0; i < lookups; ++i) {
+                    const double x = u(rng);
+                    const auto album = static_cast<unsigned>(albums * x * x);
+                    std::string url;
+                    const auto start = clk::now();
+                    auto reply = coverd_lookup(
+                        "Artist " + std::to_string(album % 23),
+                        "Album " + std::to_string(album), url);
+                    my_lat.push_back(std::chrono::duration<double, std::milli>(
+                                         clk::now() - start)
+                                         .count());
+                    ++my_counts[static_cast<int>(reply)];
+                    if (reply == CoverdReply::Hit) my_hits.insert(album);
+               }
+
+               std::lock_guard<std::mutex> lock(results_mtx);
+               lat.insert(lat.end(), my_lat.begin(), my_lat.end());
+               hit_albums.insert(my_hits.begin(), my_hits.end());
+               unavailable += my_counts[0];
+               misses += my_counts[1];
+               hits += my_counts[2];
+          });
+     }
+
+     const auto start = clk::now();
+     go.store(true);
+     for (auto& t : threads) t.join();
+     const double secs
+         = std::chrono::duration<double>(clk::now() - start).count();
+
+     kill(pid, SIGTERM);
+     std::string err;
+     char buf[512];
+     ssize_t n;
+     while ((n = read(err_pipe[0], buf, sizeof(buf))) > 0) err.append(buf, n);
+     close(err_pipe[0]);
+     waitpid(pid, nullptr, 0);
+     rmdir(dir);
+
+     unsigned long long d_lookups = 0, d_resolved = 0, d_requests = 0;
+     auto stopped = err.find("coverd: Stopped after");
+     CHECK(stopped != std::string::npos);
+     if (stopped != std::string::npos)
+          std::sscanf(err.c_str() + stopped,
+                      "coverd: Stopped after %llu lookups, %llu covers "
+                      "resolved upstream (%llu requests)",
+                      &d_lookups, &d_resolved, &d_requests);
+
+     const unsigned total = clients * lookups;
+     std::printf("%u clients x %u lookups over %u albums, %u ms upstream\n",
+                 clients, lookups, albums, latency);
+     std::printf("  %.0f lookups/s (%.2f s), p50 %.2f ms, p99 %.1f ms\n",
+                 total / secs, secs, pct(lat, 0.50), pct(lat, 0.99));
+     std::printf("  %u hits, %u misses, %u turned away\n", hits, misses,
+                 unavailable);
+     std::printf("  daemon: %llu lookups, %llu covers resolved for %zu "
+                 "albums found, %llu upstream requests\n",
+                 d_lookups, d_resolved, hit_albums.size(), d_requests);
+
+     // Each client holds at most two slots (one the daemon has not noticed
+     // closing yet): up to 32 of them fit in the daemon's 64 connections
+     if (clients <= 32) CHECK(unavailable == 0);
+     CHECK(d_lookups + unavailable == total);
+     CHECK(d_resolved == hit_albums.size());  // Each album resolved once
+
+     if (n_failed) std::fprintf(stderr, "%d checks failed\n", n_failed);
+     return n_failed ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file hedge.cpp
+ * @brief Test and latency benchmark of hedged requests
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Runs local HTTP servers that answer most requests in 5–25 ms but
+ *       a small fraction (4 % by default) only after 500 ms, like an
+ *       overloaded upstream. The same requests are sent plain and hedged,
+ *       each to its own server (hosts are tracked by host:port). Checks
+ *       that hedging cuts the p99 and stays within its budget (which cannot
+ *       be saved up for a burst), and that a hedged request records the
+ *       latency its caller actually waited, so the p95 hedging is based on
+ *       does not drift down.
+ *
+ * @code{.sh}
+ * test-hedge [-n REQUESTS] [-s SLOW_PERCENT]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fetch-hedge.hpp"
+
+using clk = std::chrono::steady_clock;
+using ms = std::chrono::milliseconds;
+
+static int n_failed = 0;
+
+#define CHECK(cond)                                                        \
+     do {                                                                  \
+          if (!(cond)) {                                                   \
+               std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, \
+                            __LINE__, #cond);                              \
+               ++n_failed;                                                 \
+          }                                                                \
+     } while (0)
+
+/** @brief Loopback HTTP server with a fraction of slow replies */
+class SlowServer {
+   public:
+     SlowServer(unsigned int slow_percent, unsigned int seed)
+         : slow_percent(slow_percent), rng(seed) {
+          fd = socket(AF_INET, SOCK_STREAM, 0);
+          sockaddr_in addr{};
+          addr.sin_family = AF_INET;
+          addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+          socklen_t len = sizeof(addr);
+          if (fd < 0 || bind(fd, (sockaddr*)&addr, len) < 0
+              || listen(fd, 64) < 0
+              || getsockname(fd, (sockaddr*)&addr, &len) < 0) {
+               std::perror("SlowServer");
+               std::exit(2);
+          }
+          port = ntohs(addr.sin_port);
+          acceptor = std::thread([this] { accept_loop(); });
+     }
+
+     ~SlowServer() {
+          stop.store(true);
+          acceptor.join();
+          while (n_conns.load()) std::this_thread::sleep_for(ms(5));
+          close(fd);
+     }
+
+     std::string url() const {
+          return "http://127.0.0.1:" + std::to_string(port) + "/";
+     }
+
+     std::string host() const { return HostLatencies::host(url()); }
+
+     /** @brief Answers the next requests after these delays, in order */
+     void script(std::initializer_list<ms> delays) {
+          std::lock_guard<std::mutex> lock(rng_mtx);
+          scripted.insert(scripted.end(), delays);
+     }
+
+   private:
+     void accept_loop() {
+          pollfd pfd{fd, POLLIN, 0};
+          while (!stop.load()) {
+               if (poll(&pfd, 1, 20) <= 0) continue;
+               int conn = accept(fd, nullptr, nullptr);
+               if (conn < 0) continue;
+               ++n_conns;
+               std::thread([this, conn] {
+                    serve(conn);
+                    close(conn);
+                    --n_conns;
+               }).detach();
+          }
+     }
+
+     void serve(int conn) {
+          std::string req;
+          char buf[1024];
+          while (req.find("\r\n\r\n") == std::string::npos) {
+               ssize_t n = recv(conn, buf, sizeof(buf), 0);
+               if (n <= 0) return;
+               req.append(buf, n);
+          }
+
+          std::this_thread::sleep_for(delay());
+          static const char reply[]
+              = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n"
+                "Connection: close\r\n\r\nok";
+          send(conn, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+     }
+
+     ms delay() {
+          std::lock_guard<std::mutex> lock(rng_mtx);
+          if (!scripted.empty()) {
+               ms d = scripted.front();
+               scripted.pop_front();
+               return d;
+          }
+          if (rng() % 100 < slow_percent) return ms(500);
+          return ms(5 + rng() % 21);
+     }
+
+     const unsigned int slow_percent;
+     int fd = -1;
+     int port = 0;
+     std::thread acceptor;
+     std::atomic<bool> stop{false};
+     std::atomic<int> n_conns{0};
+     std::mutex rng_mtx;
+     std::mt19937 rng;
+     std::deque<ms> scripted;
+};
+
+/** @brief Caller-observed latencies [ms] of `n` requests, in order */
+static std::vector<double> run(const std::string& url, int n) {
+     std::vector<double> lat;
+     for (int i = 0; i < n; ++i) {
+          auto start = clk::now();
+          auto reply = fetch_hedged_reply(url);
+          lat.push_back(
+              std::chrono::duration<double, std::milli>(clk::now() - start)
+                  .count());
+          CHECK(reply && reply->status == 200 && reply->body == "ok");
+     }
+     return lat;
+}
+
+static double pct(std::vector<double> lat, double p) {
+     std::sort(lat.begin(), lat.end());
+     return lat[static_cast<std::size_t>(p * (lat.size() - 1))];
+}
+
+/**
+ * @brief A hedge winning over a slow original records the whole wait.
+ *
+ * With the latency window full of 20 ms replies, the next original takes
+ * 400 ms and its hedge (sent at the p95, ~20 ms) 20 ms. The caller waits
+ * ~40 ms, so that is what has to be recorded; the hedge's own 20 ms would
+ * hide the slow original from the p95 for good.
+ */
+static void test_hedge_records_wait() {
+     SlowServer server(0, 1);
+     for (std::size_t i = 0; i < HEDGE_SAMPLES; ++i) server.script({ms(20)});
+     fetch_hedging.store(false);  // No hedges while filling the window
+     run(server.url(), HEDGE_SAMPLES);
+     fetch_hedging.store(true);
+     auto p95 = latencies.p95(server.host());
+     CHECK(p95);
+     if (!p95) return;
+
+     server.script({ms(400), ms(20)});
+     auto start = clk::now();
+     auto reply = fetch_hedged_reply(server.url());
+     auto waited = std::chrono::duration_cast<ms>(clk::now() - start);
+     auto recorded = latencies.percentile(server.host(), 100);
+
+     std::printf("hedged request: waited %lld ms, recorded %lld ms (p95 %lld "
+                 "ms)\n",
+                 static_cast<long long>(waited.count()),
+                 static_cast<long long>(recorded ? recorded->count() : -1),
+                 static_cast<long long>(p95->count()));
+     CHECK(reply && reply->status == 200);
+     CHECK(waited < ms(200));  // Hedge won
+     CHECK(recorded && *recorded >= *p95 + ms(15));
+     CHECK(recorded && *recorded <= waited);
+}
+
+/** @brief Many requests without hedges save up no more than a small burst */
+static void test_budget_burst() {
+     while (hedge_budget_take()) {
+     }
+     for (int i = 0; i < 1000; ++i) hedge_budget_refill();
+     unsigned int taken = 0;
+     while (hedge_budget_take()) ++taken;
+     std::printf("hedge budget after 1000 requests: %u hedges\n", taken);
+     CHECK(taken == HEDGE_BURST);
+}
+
+int main(int argc, char** argv) {
+     int n = 500;
+     unsigned int slow_percent = 4;
+     for (int i = 1; i + 1 < argc; i += 2) {
+          if (!std::strcmp(argv[i], "-n"))
+               n = std::max<int>(HEDGE_SAMPLES, std::atoi(argv[i + 1]));
+          else if (!std::strcmp(argv[i], "-s"))
+               slow_percent = std::atoi(argv[i + 1]);
+     }
+
+     // Talk to the loopback servers directly, whatever the environment says
+     setenv("no_proxy", "*", 1);
+     setenv("NO_PROXY", "*", 1);
+     curl_global_init(CURL_GLOBAL_DEFAULT);
+
+     test_budget_burst();
+     test_hedge_records_wait();
+
+     SlowServer plain_server(slow_percent, 1), hedged_server(slow_percent, 1);
+
+     fetch_hedging.store(false);
+     auto plain = run(plain_server.url(), n);
+
+     fetch_hedging.store(true);
+     run(hedged_server.url(), HEDGE_SAMPLES);  // Fill the latency window
+     requests_sent.store(0);
+     hedges_sent.store(0);
+     auto hedged = run(hedged_server.url(), n);
+     auto n_requests = requests_sent.load(), n_hedges = hedges_sent.load();
+
+     // Samples kept for the host = its last HEDGE_SAMPLES requests
+     std::vector<double> last(hedged.end() - HEDGE_SAMPLES, hedged.end());
+     auto recorded_p95 = latencies.p95(hedged_server.host());
+
+     std::printf("%d requests, %u %% of them slow (500 ms)\n", n,
+                 slow_percent);
+     std::printf("  plain:  p50 %6.1f ms, p95 %6.1f ms, p99 %6.1f ms\n",
+                 pct(plain, 0.50), pct(plain, 0.95), pct(plain, 0.99));
+     std::printf("  hedged: p50 %6.1f ms, p95 %6.1f ms, p99 %6.1f ms\n",
+                 pct(hedged, 0.50), pct(hedged, 0.95), pct(hedged, 0.99));
+     std::printf("  hedges: %llu of %llu requests (%.1f %%)\n", n_hedges,
+                 n_requests, n_requests ? 100.0 * n_hedges / n_requests : 0.0);
+     if (recorded_p95)
+          std::printf("  p95 of the last %zu: recorded %lld ms, waited %.1f "
+                      "ms\n",
+                      HEDGE_SAMPLES,
+                      static_cast<long long>(recorded_p95->count()),
+                      pct(last, 0.95));
+
+     // Hedging past the p95 can only help if under 5 % of requests are slow
+     if (slow_percent < 5) CHECK(pct(hedged, 0.99) < pct(plain, 0.99));
+     CHECK(n_hedges * 100
+           <= (n_requests - n_hedges) * HEDGE_BUDGET + HEDGE_BURST * 100);
+
+     curl_global_cleanup();
+     if (n_failed) std::fprintf(stderr, "%d checks failed\n", n_failed);
+     return n_failed ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+/**
+ * @file coverd.cpp
+ * @brief Shared cover cache daemon for Audacious Discord RPC (optional)
+ * @version 2.2
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note One daemon serves all Audacious instances on a host (e.g. several
+ *       user sessions) over a Unix domain socket, see coverd.hpp for the
+ *       protocol. It owns one persistent cover cache, resolves each album
+ *       only once even if several clients ask at the same time, and keeps
+ *       the whole host within one upstream rate limit.
+ *
+ *       The socket is only accessible to the daemon's user unless --shared
+ *       is given (e.g. for a system-wide daemon in /run), and each client
+ *       is checked by its peer credentials. A stale socket is only removed
+ *       if it is the daemon user's own and nobody listens on it anymore.
+ *
+ * @code{.sh}
+ * discord-rpc-coverd [--socket PATH] [--cache FILE] [--interval MS] [--itunes]
+ *                    [--shared]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define AUDINFO(...) fprintf(stderr, __VA_ARGS__)
+#define AUDERR(...) fprintf(stderr, __VA_ARGS__)
+
+#include "covers.hpp"
+
+constexpr unsigned int COVERD_SAVE_INTERVAL = 60000;  // [ms]
+constexpr int COVERD_MAX_CLIENTS = 64;  // Connections served at once
+
+static volatile std::sig_atomic_t stopping = 0;
+static bool shared = false;  //< Serve other users, not just our own
+static std::atomic<int> n_clients{0};
+
+/* === In-flight De-duplication === */
+
+/* Lookups of the same key share one future; only the first asking client
+ * actually resolves it, the others wait for the same result. */
+static std::mutex inflight_mtx;
+static std::map<std::string, std::shared_future<std::optional<std::string>>>
+    inflight;
+static std::atomic<bool> cache_dirty{false};
+static std::atomic<unsigned long long> n_lookups{0}, n_resolved{0};
+
+static std::optional<std::string> resolve(const std::string& artist,
+                                          const std::string& album) {
+     RPCStats::bump(n_lookups);
+     auto cache_res = cache.get(artist, album);
+     if (cache_res) return cache_res;
+     if (auto stale = cache.get_stale(artist, album)) {
+          // Client gets it now, as it was; the refreshed one is saved later
+          cover_refresh(artist, album, nullptr, 0, 0,
+                        [] { cache_dirty.store(true); });
+          return stale->url;
+     }
+
+     const std::string k = CoverArtCache::key(artist, album);
+     std::promise<std::optional<std::string>> promise;
+     std::shared_future<std::optional<std::string>> future;
+     bool owner = false;
+     {
+          std::lock_guard<std::mutex> lock(inflight_mtx);
+          auto it = inflight.find(k);
+          if (it != inflight.end()) {
+               future = it->second;
+          } else {
+               // Owners put the cover before leaving inflight: if one just
+               // finished since the check above, its cover is here now
+               cache_res = cache.get(artist, album);
+               if (cache_res) return cache_res;
+               future = promise.get_future().share();
+               inflight.emplace(k, future);
+               owner = true;
+          }
+     }
+     if (!owner) return future.get();
+
+     auto res = cover_race(artist, album, nullptr, 0);
+     std::optional<std::string> url;
+     if (res) {
+          cache.put(artist, album, res->url, res->validators);
+          cache_dirty.store(true);
+          RPCStats::bump(n_resolved);
+          url = res->url;
+     }
+     {
+          std::lock_guard<std::mutex> lock(inflight_mtx);
+          inflight.erase(k);
+     }
+     promise.set_value(url);
+     return url;
+}
+
+/* === Clients === */
+
+static bool client_allowed(int fd) {
+     uid_t uid;
+     if (!coverd_peer_uid(fd, uid)) return false;
+     return shared || uid == geteuid() || uid == 0;
+}
+
+static void serve(int fd) {
+     std::string buf;
+     char chunk[1024];
+     bool alive = true;
+     while (alive && !stopping) {
+          ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+          if (n <= 0) break;
+          buf.append(chunk, n);
+          if (buf.size() > 8192) break;  // Not a sane request
+
+          std::size_t eol;
+          while (alive && (eol = buf.find('\n')) != std::string::npos) {
+               std::string req = buf.substr(0, eol);
+               buf.erase(0, eol + 1);
+
+               auto sep = req.find('\x1F');
+               std::string reply = "\n";
+               if (sep != std::string::npos) {
+                    auto url = resolve(req.substr(0, sep), req.substr(sep + 1));
+                    if (url && coverd_url_ok(*url)) reply = *url + '\n';
+               }
+               alive = send(fd, reply.data(), reply.size(), MSG_NOSIGNAL)
+                       == static_cast<ssize_t>(reply.size());
+          }
+     }
+     close(fd);
+     --n_clients;
+}
+
+/* === Socket === */
+
+static std::string default_socket_path() {
+     const char* path = getenv(COVERD_SOCKET_ENV);
+     if (path && *path) return path;
+     const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+     if (geteuid() != 0 && runtime_dir && *runtime_dir)
+          return std::string(runtime_dir) + "/" COVERD_SOCKET_NAME;
+     return COVERD_SOCKET_SYSTEM;
+}
+
+/**
+ * @brief Removes a socket left behind by a previous run of ours.
+ * @return false if the path is taken (by something else, or a live daemon)
+ */
+static bool remove_stale_socket(const std::string& path,
+                                const sockaddr_un& addr) {
+     struct stat st;
+     if (lstat(path.c_str(), &st) < 0) return errno == ENOENT;
+     if (!S_ISSOCK(st.st_mode) || st.st_uid != geteuid()) {
+          fprintf(stderr, "coverd: %s exists and is not our socket\n",
+                  path.c_str());
+          return false;
+     }
+
+     int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+     bool live = fd >= 0
+                 && connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                            sizeof(addr))
+                        == 0;
+     if (fd >= 0) close(fd);
+     if (live) {
+          fprintf(stderr, "coverd: Another daemon is listening on %s\n",
+                  path.c_str());
+          return false;
+     }
+     return unlink(path.c_str()) == 0;
+}
+
+/* === Main === */
+
+static void usage(const char* argv0) {
+     fprintf(stderr,
+             "Usage: %s [--socket PATH] [--cache FILE] [--interval MS] "
+             "[--itunes] [--shared]\n"
+             "  --socket PATH  Socket to listen on (default: $%s, else\n"
+             "                 $XDG_RUNTIME_DIR/%s, or %s as root)\n"
+             "  --cache FILE   Persist the cover cache to FILE\n"
+             "  --interval MS  Min. time between requests to one upstream "
+             "host (default: 1000)\n"
+             "  --itunes       Also race the iTunes provider\n"
+             "  --shared       Serve all users, not only this one\n",
+             argv0, COVERD_SOCKET_ENV, COVERD_SOCKET_NAME,
+             COVERD_SOCKET_SYSTEM);
+}
+
+int main(int argc, char** argv) {
+     std::string socket_path = default_socket_path();
+     std::string cache_path;
+     long interval_ms = 1000;  // MusicBrainz allows 1 req/s per IP
+     for (int i = 1; i < argc; ++i) {
+          if (!strcmp(argv[i], "--socket") && i + 1 < argc) {
+               socket_path = argv[++i];
+          } else if (!strcmp(argv[i], "--cache") && i + 1 < argc) {
+               cache_path = argv[++i];
+          } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+               interval_ms = strtol(argv[++i], nullptr, 10);
+          } else if (!strcmp(argv[i], "--itunes")) {
+               itunes_provider.enabled.store(true);
+          } else if (!strcmp(argv[i], "--shared")) {
+               shared = true;
+          } else {
+               usage(argv[0]);
+               return 2;
+          }
+     }
+
+     RateLimiter limiter{std::chrono::milliseconds(interval_ms)};
+     fetch_limiter = &limiter;
+
+     if (!cache_path.empty())
+          fprintf(stderr, "coverd: Loaded %zu cached covers from %s\n",
+                  cache.load(cache_path), cache_path.c_str());
+
+     sockaddr_un addr{};
+     addr.sun_family = AF_UNIX;
+     if (socket_path.size() >= sizeof(addr.sun_path)) {
+          fprintf(stderr, "coverd: Socket path too long\n");
+          return 1;
+     }
+     strcpy(addr.sun_path, socket_path.c_str());
+
+     if (socket_path == COVERD_SOCKET_SYSTEM)
+          mkdir("/run/audacious-discord-rpc", 0755);  // Gone after reboots
+     if (!remove_stale_socket(socket_path, addr)) return 1;
+
+     int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+     if (listen_fd < 0) {
+          perror("coverd: socket");
+          return 1;
+     }
+     const mode_t old_umask = umask(0177);  // Born 0600, no window
+     const bool bound = bind(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                             sizeof(addr))
+                        == 0;
+     umask(old_umask);
+     struct stat bound_st;
+     if (!bound || listen(listen_fd, 64) < 0
+         || lstat(socket_path.c_str(), &bound_st) < 0) {
+          perror("coverd: bind/listen");
+          close(listen_fd);
+          return 1;
+     }
+     if (shared)  // Other users’ players are clients too
+          chmod(socket_path.c_str(), 0666);
+
+     signal(SIGINT, [](int) { stopping = 1; });
+     signal(SIGTERM, [](int) { stopping = 1; });
+     signal(SIGPIPE, SIG_IGN);
+     curl_global_init(CURL_GLOBAL_DEFAULT);
+     fprintf(stderr, "coverd: Listening on %s\n", socket_path.c_str());
+
+     auto last_save = std::chrono::steady_clock::now();
+     while (!stopping) {
+          pollfd pfd{listen_fd, POLLIN, 0};
+          if (poll(&pfd, 1, 1000) > 0) {
+               int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+               if (fd >= 0 && n_clients.load() < COVERD_MAX_CLIENTS
+                   && client_allowed(fd)) {
+                    // Idle clients must not hold their slot forever
+                    timeval timeo{COVERD_TIMEOUT / 1000, 0};
+                    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeo,
+                               sizeof(timeo));
+                    ++n_clients;
+                    std::thread(serve, fd).detach();
+               } else if (fd >= 0) {
+                    close(fd);  // Client falls back to looking up itself
+               }
+          }
+
+          if (!cache_path.empty() && cache_dirty.load()
+              && std::chrono::steady_clock::now() - last_save
+                     > std::chrono::milliseconds(COVERD_SAVE_INTERVAL)) {
+               cache_dirty.store(false);
+               last_save = std::chrono::steady_clock::now();
+               if (!cache.save(cache_path, true))
+                    fprintf(stderr, "coverd: Cannot save cache to %s\n",
+                            cache_path.c_str());
+          }
+     }
+
+     close(listen_fd);
+     struct stat st;  // Only our own socket, not one that replaced it
+     if (lstat(socket_path.c_str(), &st) == 0 && st.st_ino == bound_st.st_ino
+         && st.st_dev == bound_st.st_dev)
+          unlink(socket_path.c_str());
+     if (!cache_path.empty() && !cache.save(cache_path, true))
+          fprintf(stderr, "coverd: Cannot save cache to %s\n",
+                  cache_path.c_str());
+     fprintf(stderr,
+             "coverd: Stopped after %llu lookups, %llu covers resolved "
+             "upstream (%llu requests)\n",
+             n_lookups.load(), n_resolved.load(), stats.fetches.load());
+     return 0;
+}
@@ -0,0 +1,1117 @@
+/**
+ * @file replay.cpp
+ * @brief Hook trace replay runner for Audacious Discord RPC
+ * @version 2.2
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Plays the part of Audacious for the unmodified plugin (built into
+ *       this binary against the stand-in headers in tools/replay/): loads
+ *       it, feeds it the hooks of a trace recorded with AUD_DISCORD_RPC_RECORD
+ *       (see hook-recorder.hpp) or generated here, and reports what the
+ *       session cost – threads, fetches, presence sends, CPU time (also
+ *       per hook) and memory. Discord and the cover art upstreams are
+ *       stand-ins too, so runs are repeatable and offline. The Discord one
+ *       speaks the real IPC protocol and can come up late or restart, to
+ *       time how long the plugin takes to init and to show a presence.
+ *
+ *       Trace time is virtual: the stream throttling and queued functions
+ *       of the plugin run on it, so hours of radio replay in seconds. Only
+ *       cover lookups need real time (for their debounce and requests), so
+ *       after a hook that started one, the runner waits for real – as long
+ *       as the trace says, but at most --max-gap.
+ *
+ * @code{.sh}
+ * discord-rpc-replay [OPTIONS] TRACE
+ * discord-rpc-replay [OPTIONS] --synth session|radio|library [--dump]
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "coverd.hpp"
+#include "discord-rpc.hpp"
+#include "fetch-replay.hpp"
+#include "hook-recorder.hpp"
+#include "stats.hpp"
+
+#define COVER_CACHE_FILE "discord-rpc-covers.tsv"  // As in the plugin
+
+constexpr unsigned int REPLAY_MAX_GAP = 2500;        // [ms], > FETCH_DEBOUNCE
+constexpr unsigned int REPLAY_DISCORD_WAIT = 70000;  // [ms] for a presence
+
+using clk = std::chrono::steady_clock;
+
+/* === Trace === */
+
+/** @brief One hook, as recorded by HookRecorder (+ optional art column) */
+struct Event {
+     long long ms = 0;  //< Trace time
+     std::string hook;
+     bool playing = false, ready = false, paused = false;
+     int time = 0;  //< Playback position [ms]
+     std::string filename, title, artist, album, album_artist;
+     int length = -1;  //< [ms], -1 = unknown
+     std::string art;  //< Embedded cover (any bytes identifying it)
+};
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+     std::vector<std::string> fields;
+     std::size_t begin = 0, end;
+     while ((end = line.find('\t', begin)) != std::string::npos) {
+          fields.push_back(line.substr(begin, end - begin));
+          begin = end + 1;
+     }
+     fields.push_back(line.substr(begin));
+     return fields;
+}
+
+static bool read_trace(const std::string& path, std::vector<Event>& events) {
+     std::ifstream in(path);
+     if (!in) return false;
+     std::string line;
+     while (std::getline(in, line)) {
+          if (line.empty() || line[0] == '#') continue;
+          auto f = split_tabs(line);
+          if (f.size() < 12) continue;
+          Event e;
+          e.ms = std::atoll(f[0].c_str());
+          e.hook = f[1];
+          e.playing = f[2] == "1";
+          e.ready = f[3] == "1";
+          e.paused = f[4] == "1";
+          e.time = std::atoi(f[5].c_str());
+          e.filename = f[6];
+          e.title = f[7];
+          e.artist = f[8];
+          e.album = f[9];
+          e.album_artist = f[10];
+          e.length = std::atoi(f[11].c_str());
+          if (f.size() > 12) e.art = f[12];
+          events.push_back(std::move(e));
+     }
+     return true;
+}
+
+static void write_trace(FILE* out, const std::vector<Event>& events) {
+     fprintf(out,
+             "#ms\thook\tplaying\tready\tpaused\ttime\tfilename\ttitle\t"
+             "artist\talbum\talbum_artist\tlength\tart\n");
+     for (const Event& e : events)
+          fprintf(out, "%lld\t%s\t%d\t%d\t%d\t%d\t%s\t%s\t%s\t%s\t%s\t%d\t%s\n",
+                  e.ms, e.hook.c_str(), e.playing, e.ready, e.paused, e.time,
+                  e.filename.c_str(), e.title.c_str(), e.artist.c_str(),
+                  e.album.c_str(), e.album_artist.c_str(), e.length,
+                  e.art.c_str());
+}
+
+/* === Synthetic Traces === */
+
+/* Deterministic for a seed, so before/after runs see the same session */
+class TraceGen {
+   public:
+     TraceGen(unsigned int seed, double hours)
+         : rng(seed), end_ms(static_cast<long long>(hours * 3600000)) {}
+
+     /** @brief Albums in full, with skip storms, pauses and seeks */
+     std::vector<Event> session() {
+          while (t < end_ms) {
+               const int album = pick(0, 59);
+               const int n_tracks = pick(8, 14);
+               for (int track = 1; track <= n_tracks && t < end_ms; ++track) {
+                    Event e = album_track(album, track);
+                    if (chance(5)) {
+                         skip_storm(album, track);
+                         continue;
+                    }
+                    play(e, pick(150, 330) * 1000);
+               }
+          }
+          stop();
+          return std::move(events);
+     }
+
+     /** @brief Internet radio: ICY repeats, a local file now and then */
+     std::vector<Event> radio() {
+          int station = 0;
+          while (t < end_ms) {
+               // ~40 min per station, sometimes interrupted by a local file
+               const long long station_end = t + pick(30, 50) * 60000LL;
+               std::string icy = song_title();
+               emit("playback ready", stream(station, icy));
+               while (t < station_end && t < end_ms) {
+                    t += pick(10, 30) * 1000;  // ICY metadata interval
+                    if (chance(12)) icy = song_title();  // ~3.5 min songs
+                    emit("title change", stream(station, icy));
+                    if (chance(1)) {
+                         // A file, then straight back (no "playback end")
+                         Event file = album_track(pick(0, 59), pick(1, 12));
+                         file.length = pick(150, 330) * 1000;
+                         emit("playback ready", file);
+                         t += pick(20, 120) * 1000;
+                         emit("playback ready", stream(station, icy));
+                    }
+               }
+               station = (station + 1) % 3;
+          }
+          stop();
+          return std::move(events);
+     }
+
+     /**
+      * @brief Shuffled library whose album tags vary within one release
+      *        (discs, editions, missing album artist), while the embedded
+      *        cover stays the same.
+      */
+     std::vector<Event> library() {
+          static const char* const variants[]
+              = {"", " (Disc 1)", " (Disc 2)", " [Remastered]", " (Deluxe)"};
+          while (t < end_ms) {
+               const int release = pick(0, 299);
+               Event e = album_track(release, pick(1, 12));
+               if (chance(50))
+                    e.album += variants[pick(1, std::size(variants) - 1)];
+               if (chance(25)) {
+                    e.album_artist.clear();
+                    e.artist += " feat. Guest " + std::to_string(pick(1, 9));
+               }
+               e.art = "art-" + std::to_string(release);
+               play(e, pick(150, 330) * 1000);
+          }
+          stop();
+          return std::move(events);
+     }
+
+   private:
+     int pick(int lo, int hi) {
+          return std::uniform_int_distribution<int>(lo, hi)(rng);
+     }
+     bool chance(int percent) { return pick(1, 100) <= percent; }
+
+     std::string song_title() {
+          return "Artist " + std::to_string(pick(1, 400)) + " - Song "
+                 + std::to_string(pick(1, 5000));
+     }
+
+     Event album_track(int album, int track) {
+          Event e;
+          e.playing = e.ready = true;
+          e.artist = e.album_artist = "Artist " + std::to_string(album % 23);
+          e.album = "Album " + std::to_string(album);
+          e.title = "Track " + std::to_string(track);
+          e.filename = "file:///music/" + std::to_string(album) + "/"
+                       + std::to_string(track) + ".flac";
+          return e;
+     }
+
+     Event stream(int station, const std::string& icy) {
+          Event e;
+          e.playing = e.ready = true;
+          e.filename = "https://radio.example/station"
+                       + std::to_string(station) + "/stream.mp3";
+          e.title = icy;
+          return e;
+     }
+
+     void emit(const char* hook, Event e) {
+          e.ms = t;
+          e.hook = hook;
+          events.push_back(std::move(e));
+     }
+
+     /** @brief Plays a track to its end, maybe pausing or seeking */
+     void play(Event e, int length) {
+          e.length = length;
+          emit("playback ready", e);
+          if (chance(30)) {
+               t += 300;
+               emit("title change", e);  // Tuple refined after start
+          }
+          int at = 0;
+          if (chance(10)) {
+               at = pick(10, length / 1000 - 5) * 1000;
+               t += at;
+               e.time = at;
+               e.paused = true;
+               emit("playback pause", e);
+               t += pick(5, 300) * 1000;
+               e.paused = false;
+               emit("playback unpause", e);
+          }
+          if (chance(8)) {
+               const int to = pick(at / 1000, length / 1000 - 5) * 1000;
+               t += 2000;
+               at += 2000;
+               e.time = to;
+               emit("playback seek", e);
+               at = to;
+          }
+          t += length - at;
+          e.time = length;
+          e.ready = false;
+          emit("playback end", e);
+     }
+
+     void skip_storm(int album, int track) {
+          for (int i = 0, n = pick(4, 10); i < n; ++i) {
+               Event e = album_track(album, track + i);
+               e.length = pick(150, 330) * 1000;
+               emit("playback ready", e);
+               t += pick(150, 900);
+          }
+     }
+
+     void stop() {
+          t += 1000;
+          emit("playback stop", Event());
+     }
+
+     std::mt19937 rng;
+     const long long end_ms;
+     long long t = 0;
+     std::vector<Event> events;
+};
+
+/* === Host (libaudcore stand-in) === */
+
+static struct {
+     int log_level = audlog::Warning;
+     std::map<std::string, std::string> config;  //< Key: section/name
+     std::string user_dir;
+
+     // Playback, as of the current event
+     Event now;
+     Index<char> art;
+     int position = -1;
+
+     std::mutex hooks_mtx;
+     std::vector<std::tuple<std::string, HookFunction, void*>> hooks;
+
+     std::atomic<long long> trace_ns{0};
+     std::mutex timers_mtx;
+     std::map<const QueuedFunc*, std::tuple<long long, QueuedFunc::Func, void*>>
+         timers;  //< Due [ns], function, data
+} host;
+
+namespace audlog {
+void log(Level level, const char*, int, const char*, const char* format,
+         ...) {
+     if (level < host.log_level) return;
+     va_list args;
+     va_start(args, format);
+     vfprintf(stderr, format, args);
+     va_end(args);
+}
+}  // namespace audlog
+
+StringBuf str_concat(std::initializer_list<const char*> strings) {
+     std::string s;
+     for (const char* str : strings) s += str ? str : "";
+     return StringBuf(std::move(s));
+}
+
+StringBuf str_copy(const char* str, int len) {
+     return StringBuf(len < 0 ? std::string(str) : std::string(str, len));
+}
+
+StringBuf int_to_str(int val) {
+     // Kept for good, like the config defaults it ends up in
+     static std::mutex mtx;
+     static std::set<std::string> interned;
+     std::lock_guard<std::mutex> lock(mtx);
+     return StringBuf("", interned.insert(std::to_string(val)).first->c_str());
+}
+
+int strcmp_safe(const char* a, const char* b, int len) {
+     if (!a) return b ? -1 : 0;
+     if (!b) return 1;
+     return len < 0 ? strcmp(a, b) : strncmp(a, b, len);
+}
+
+Tuple::ValueType Tuple::get_value_type(Field field) const {
+     return types[field];
+}
+int Tuple::get_int(Field field) const { return ints[field]; }
+::String Tuple::get_str(Field field) const { return strs[field]; }
+
+void Tuple::set_str(Field field, const char* str) {
+     strs[field] = ::String(str);
+     types[field] = String;
+}
+
+void Tuple::set_int(Field field, int val) {
+     ints[field] = val;
+     types[field] = Int;
+}
+
+static String opt_str(const std::string& s) {
+     return s.empty() ? String() : String(s.c_str());
+}
+
+bool aud_drct_get_playing() { return host.now.playing; }
+bool aud_drct_get_ready() { return host.now.playing && host.now.ready; }
+bool aud_drct_get_paused() { return host.now.paused; }
+int aud_drct_get_time() { return host.now.time; }
+String aud_drct_get_filename() { return opt_str(host.now.filename); }
+
+Tuple aud_drct_get_tuple() {
+     Tuple tuple;
+     const Event& e = host.now;
+     if (!e.title.empty()) tuple.set_str(Tuple::Title, e.title.c_str());
+     if (!e.artist.empty()) tuple.set_str(Tuple::Artist, e.artist.c_str());
+     if (!e.album.empty()) tuple.set_str(Tuple::Album, e.album.c_str());
+     if (!e.album_artist.empty())
+          tuple.set_str(Tuple::AlbumArtist, e.album_artist.c_str());
+     if (e.length >= 0) tuple.set_int(Tuple::Length, e.length);
+     auto slash = e.filename.rfind('/');
+     if (slash != std::string::npos)
+          tuple.set_str(Tuple::Basename, e.filename.c_str() + slash + 1);
+     return tuple;
+}
+
+void hook_associate(const char* name, HookFunction func, void* user) {
+     std::lock_guard<std::mutex> lock(host.hooks_mtx);
+     host.hooks.emplace_back(name, func, user);
+}
+
+void hook_dissociate(const char* name, HookFunction func, void* user) {
+     std::lock_guard<std::mutex> lock(host.hooks_mtx);
+     std::erase_if(host.hooks, [&](auto& hook) {
+          return std::get<0>(hook) == name && std::get<1>(hook) == func
+                 && (!user || std::get<2>(hook) == user);
+     });
+}
+
+void hook_call(const char* name, void* data) {
+     std::vector<std::pair<HookFunction, void*>> calls;
+     {
+          std::lock_guard<std::mutex> lock(host.hooks_mtx);
+          for (auto& [hook, func, user] : host.hooks)
+               if (hook == name) calls.emplace_back(func, user);
+     }
+     for (auto& [func, user] : calls) func(data, user);
+}
+
+const char* aud_get_path(AudPath) { return host.user_dir.c_str(); }
+
+void aud_config_set_defaults(const char* section, const char* const* entries) {
+     for (; entries && entries[0] && entries[1]; entries += 2)
+          host.config.try_emplace(std::string(section) + "/" + entries[0],
+                                  entries[1]);
+}
+
+String aud_get_str(const char* section, const char* name) {
+     auto it = host.config.find(std::string(section) + "/" + name);
+     return String(it == host.config.end() ? "" : it->second.c_str());
+}
+
+bool aud_get_bool(const char* section, const char* name) {
+     return !strcmp(aud_get_str(section, name), "TRUE");
+}
+
+int aud_get_int(const char* section, const char* name) {
+     return std::atoi(aud_get_str(section, name));
+}
+
+replay::clock::time_point replay::clock::now() noexcept {
+     return time_point(duration(host.trace_ns.load()));
+}
+
+void QueuedFunc::queue(int delay_ms, Func func, void* data) {
+     std::lock_guard<std::mutex> lock(host.timers_mtx);
+     host.timers[this] = {host.trace_ns.load() + delay_ms * 1000000LL, func,
+                          data};
+}
+
+void QueuedFunc::stop() {
+     std::lock_guard<std::mutex> lock(host.timers_mtx);
+     host.timers.erase(this);
+}
+
+bool QueuedFunc::running() const {
+     std::lock_guard<std::mutex> lock(host.timers_mtx);
+     return host.timers.contains(this);
+}
+
+/* === Costs === */
+
+/** @brief Main-thread CPU time spent in the plugin, per hook */
+struct HookCost {
+     unsigned long long calls = 0;
+     long long cpu_ns = 0, max_ns = 0;
+};
+
+static std::map<std::string, HookCost> hook_costs;
+
+static long long thread_cpu_ns() {
+     timespec ts;
+     clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** @brief Calls into the plugin, charging its CPU time to `name` */
+template <class F>
+static void charged(const std::string& name, F&& call) {
+     const long long start = thread_cpu_ns();
+     call();
+     const long long ns = thread_cpu_ns() - start;
+     HookCost& cost = hook_costs[name];
+     ++cost.calls;
+     cost.cpu_ns += ns;
+     cost.max_ns = std::max(cost.max_ns, ns);
+}
+
+/** @brief Advances trace time, running queued functions as they fall due */
+static void advance_to(long long ms) {
+     const long long target = ms * 1000000LL;
+     for (;;) {
+          QueuedFunc::Func func = nullptr;
+          void* data = nullptr;
+          {
+               std::lock_guard<std::mutex> lock(host.timers_mtx);
+               auto first = std::min_element(
+                   host.timers.begin(), host.timers.end(),
+                   [](auto& a, auto& b) {
+                        return std::get<0>(a.second) < std::get<0>(b.second);
+                   });
+               if (first == host.timers.end()
+                   || std::get<0>(first->second) > target)
+                    break;
+               host.trace_ns.store(
+                   std::max(host.trace_ns.load(), std::get<0>(first->second)));
+               func = std::get<1>(first->second);
+               data = std::get<2>(first->second);
+               host.timers.erase(first);
+          }
+          charged("(queued function)", [&] { func(data); });
+     }
+     host.trace_ns.store(std::max(host.trace_ns.load(), target));
+}
+
+Playlist Playlist::playing_playlist() {
+     Playlist list;
+     list.id = 0;
+     return list;
+}
+
+int Playlist::get_position() const { return host.position; }
+
+AudArtPtr aud_art_request(const char*, int, bool* queued) {
+     if (queued) *queued = false;
+     return host.art.len() ? AudArtPtr(&host.art) : AudArtPtr();
+}
+
+/* === Discord (stand-in) === */
+
+/* IPC frames: op and payload length (both u32 LE), then the JSON payload */
+enum IPCOp : std::uint32_t { Handshake = 0, Frame = 1, Close = 2 };
+
+static bool ipc_write(int fd, std::uint32_t op, const std::string& json) {
+     std::string msg(8, '\0');
+     const auto len = static_cast<std::uint32_t>(json.size());
+     for (int i = 0; i < 4; ++i) {
+          msg[i] = static_cast<char>(op >> (8 * i));
+          msg[4 + i] = static_cast<char>(len >> (8 * i));
+     }
+     msg += json;
+     for (std::size_t sent = 0; sent < msg.size();) {
+          ssize_t n = send(fd, msg.data() + sent, msg.size() - sent,
+                           MSG_NOSIGNAL);
+          if (n <= 0) return false;
+          sent += n;
+     }
+     return true;
+}
+
+static bool ipc_recv(int fd, char* buf, std::size_t len) {
+     for (std::size_t got = 0; got < len;) {
+          ssize_t n = recv(fd, buf + got, len - got, 0);
+          if (n <= 0) return false;
+          got += n;
+     }
+     return true;
+}
+
+static bool ipc_read(int fd, std::uint32_t& op, std::string& json) {
+     unsigned char header[8];
+     if (!ipc_recv(fd, reinterpret_cast<char*>(header), sizeof(header)))
+          return false;
+     std::uint32_t len = 0;
+     op = 0;
+     for (int i = 3; i >= 0; --i) {
+          op = (op << 8) | header[i];
+          len = (len << 8) | header[4 + i];
+     }
+     if (len > 65536) return false;
+     json.resize(len);
+     return ipc_recv(fd, json.data(), len);
+}
+
+/* Where Discord (and discord-presence) puts its socket */
+static std::string ipc_path() {
+     for (const char* env : {"XDG_RUNTIME_DIR", "TMPDIR", "TMP", "TEMP"}) {
+          const char* dir = getenv(env);
+          if (dir && *dir) return std::string(dir) + "/discord-ipc-0";
+     }
+     return "/tmp/discord-ipc-0";
+}
+
+namespace discord {
+RPCManager& RPCManager::get() {
+     static RPCManager instance;
+     return instance;
+}
+
+RPCManager& RPCManager::setClientID(std::string_view id) {
+     client_id = id;
+     return *this;
+}
+
+RPCManager& RPCManager::onReady(std::function<void(const User&)> callback) {
+     on_ready = std::move(callback);
+     return *this;
+}
+
+RPCManager& RPCManager::onDisconnected(
+    std::function<void(int, std::string_view)> callback) {
+     on_disconnected = std::move(callback);
+     return *this;
+}
+
+RPCManager& RPCManager::onErrored(
+    std::function<void(int, std::string_view)> callback) {
+     on_errored = std::move(callback);
+     return *this;
+}
+
+RPCManager& RPCManager::initialize() {
+     std::lock_guard<std::mutex> lock(mtx);
+     if (fd >= 0) return *this;
+
+     sockaddr_un addr{};
+     addr.sun_family = AF_UNIX;
+     const std::string path = ipc_path();
+     std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+     int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+     if (sock < 0) return *this;
+     if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+         || !ipc_write(sock, Handshake,
+                       nlohmann::json{{"v", 1}, {"client_id", client_id}}
+                           .dump())) {
+          close(sock);  // Discord is not running (yet)
+          return *this;
+     }
+
+     fd = sock;
+     closing = false;
+     reader = std::thread(&RPCManager::read_loop, this, sock);
+     return *this;
+}
+
+void RPCManager::read_loop(int sock) {
+     std::uint32_t op;
+     std::string payload;
+     while (ipc_read(sock, op, payload) && op != Close) {
+          auto msg = nlohmann::json::parse(payload, nullptr, false);
+          if (msg.is_object() && msg.value("evt", nlohmann::json()) == "READY"
+              && on_ready)
+               on_ready(User{"0", "replay"});
+     }
+
+     bool dropped;
+     {
+          std::lock_guard<std::mutex> lock(mtx);
+          dropped = !closing;
+     }
+     if (dropped && on_disconnected) on_disconnected(2, "Connection closed");
+}
+
+void RPCManager::shutdown() {
+     std::thread old_reader;
+     {
+          std::lock_guard<std::mutex> lock(mtx);
+          if (fd < 0) return;
+          closing = true;
+          ::shutdown(fd, SHUT_RDWR);
+          old_reader = std::move(reader);
+     }
+     old_reader.join();
+     std::lock_guard<std::mutex> lock(mtx);
+     close(fd);
+     fd = -1;
+}
+
+bool RPCManager::send(unsigned int op, const std::string& json) {
+     std::lock_guard<std::mutex> lock(mtx);
+     return fd >= 0 && !closing && ipc_write(fd, op, json);
+}
+
+RPCManager& RPCManager::setPresence(const Presence& p) {
+     presence = p;
+     return *this;
+}
+
+static nlohmann::json activity_command(nlohmann::json activity) {
+     static std::atomic<unsigned long long> nonce{0};
+     return {{"cmd", "SET_ACTIVITY"},
+             {"args", {{"pid", getpid()}, {"activity", std::move(activity)}}},
+             {"nonce", std::to_string(++nonce)}};
+}
+
+RPCManager& RPCManager::refresh() {
+     nlohmann::json assets{{"large_image", presence.large_image_key},
+                           {"large_text", presence.large_image_text}};
+     if (!presence.small_image_key.empty()) {
+          assets["small_image"] = presence.small_image_key;
+          assets["small_text"] = presence.small_image_text;
+     }
+     nlohmann::json activity{
+         {"type", static_cast<int>(presence.activity_type)},
+         {"status_display_type",
+          static_cast<int>(presence.status_display_type)},
+         {"assets", std::move(assets)}};
+     if (!presence.details.empty()) activity["details"] = presence.details;
+     if (!presence.state.empty()) activity["state"] = presence.state;
+     if (presence.start_timestamp || presence.end_timestamp)
+          activity["timestamps"] = {{"start", presence.start_timestamp},
+                                    {"end", presence.end_timestamp}};
+     send(Frame, activity_command(std::move(activity)).dump());
+     return *this;
+}
+
+RPCManager& RPCManager::clearPresence() {
+     send(Frame, activity_command(nullptr).dump());
+     return *this;
+}
+}  // namespace discord
+
+/**
+ * @brief Stand-in Discord client, listening on `discord-ipc-0`.
+ *
+ * Comes up `start` after the plugin is loaded (Discord launched later) and
+ * goes away and back up once at `restart`, if set (Discord restarted,
+ * dropping its clients). Counts the SET_ACTIVITY commands it gets and
+ * notes when the first one arrives after each start.
+ */
+class FakeDiscord {
+   public:
+     using ms = std::chrono::milliseconds;
+
+     void start(clk::time_point origin, ms up_at, ms restart_at) {
+          t0 = origin;
+          up[0] = up_at;
+          up[1] = restart_at;
+          if (up_at == ms(0)) listen_now(0);  // Already running
+          server = std::thread([this] { run(); });
+     }
+
+     void stop() {
+          {
+               std::lock_guard<std::mutex> lock(mtx);
+               stopping = true;
+          }
+          cv.notify_all();
+          if (server.joinable()) server.join();
+     }
+
+     /** @brief Whether a presence arrived after the last (re)start */
+     bool settled() const {
+          const int last = up[1] > ms(0) ? 1 : 0;
+          return presence_at[last].load() >= ms(0).count();
+     }
+
+     int phases() const { return up[1] > ms(0) ? 2 : 1; }
+     ms up_at(int phase) const { return up[phase]; }
+
+     /** @brief Time from the start to the first presence, if any arrived */
+     std::optional<double> time_to_presence(int phase) const {
+          if (presence_at[phase].load() < 0) return std::nullopt;
+          return (presence_at[phase].load() - listened_at[phase].load())
+                 / 1e6;
+     }
+
+     std::atomic<unsigned long long> updates{0}, clears{0};
+
+   private:
+     long long since_t0() const {
+          return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clk::now() - t0)
+              .count();
+     }
+
+     bool wait_until(ms at) {
+          std::unique_lock<std::mutex> lock(mtx);
+          return !cv.wait_until(lock, t0 + at, [this] { return stopping; });
+     }
+
+     void listen_now(int phase) {
+          const std::string path = ipc_path();
+          sockaddr_un addr{};
+          addr.sun_family = AF_UNIX;
+          std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+          unlink(path.c_str());
+          listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+          if (listener < 0
+              || bind(listener, reinterpret_cast<sockaddr*>(&addr),
+                      sizeof(addr))
+                     < 0
+              || listen(listener, 8) < 0) {
+               perror("replay: Discord stand-in");
+               std::exit(1);
+          }
+          listened_at[phase].store(since_t0());
+     }
+
+     void close_all() {
+          for (int conn : conns) close(conn);
+          conns.clear();
+          close(listener);
+          listener = -1;
+          unlink(ipc_path().c_str());
+     }
+
+     void run() {
+          if (up[0] > ms(0)) {
+               if (!wait_until(up[0])) return;
+               listen_now(0);
+          }
+          serve(0, up[1] > ms(0) ? up[1] : ms::max());
+          if (up[1] > ms(0) && !is_stopping()) {
+               close_all();  // Discord quits…
+               listen_now(1);  // …and is back right away
+               serve(1, ms::max());
+          }
+          close_all();
+     }
+
+     bool is_stopping() {
+          std::lock_guard<std::mutex> lock(mtx);
+          return stopping;
+     }
+
+     void serve(int phase, ms until) {
+          while (!is_stopping()
+                 && (until == ms::max() || clk::now() < t0 + until)) {
+               std::vector<pollfd> fds{{listener, POLLIN, 0}};
+               for (int conn : conns) fds.push_back({conn, POLLIN, 0});
+               if (poll(fds.data(), fds.size(), 10) <= 0) continue;
+
+               if (fds[0].revents & POLLIN) {
+                    int conn = accept4(listener, nullptr, nullptr,
+                                       SOCK_CLOEXEC);
+                    if (conn >= 0) conns.push_back(conn);
+               }
+               for (std::size_t i = 1; i < fds.size(); ++i) {
+                    if (!fds[i].revents) continue;
+                    if (!handle(phase, fds[i].fd)) {
+                         close(fds[i].fd);
+                         std::erase(conns, fds[i].fd);
+                    }
+               }
+          }
+     }
+
+     /** @brief Answers one frame of a client; false once it is gone */
+     bool handle(int phase, int conn) {
+          std::uint32_t op;
+          std::string payload;
+          if (!ipc_read(conn, op, payload) || op == Close) return false;
+          auto msg = nlohmann::json::parse(payload, nullptr, false);
+          if (!msg.is_object()) return false;
+
+          if (op == Handshake) {
+               return ipc_write(
+                   conn, Frame,
+                   nlohmann::json{
+                       {"cmd", "DISPATCH"},
+                       {"evt", "READY"},
+                       {"data",
+                        {{"v", 1},
+                         {"user", {{"id", "0"}, {"username", "replay"}}}}}}
+                       .dump());
+          }
+          if (msg.value("cmd", "") != "SET_ACTIVITY") return true;
+
+          const auto& activity = msg["args"]["activity"];
+          ++(activity.is_null() ? clears : updates);
+          long long none = -1;
+          presence_at[phase].compare_exchange_strong(none, since_t0());
+          return ipc_write(conn, Frame,
+                           nlohmann::json{{"cmd", "SET_ACTIVITY"},
+                                          {"evt", nullptr},
+                                          {"nonce", msg["nonce"]},
+                                          {"data", activity}}
+                               .dump());
+     }
+
+     clk::time_point t0;
+     ms up[2];
+     std::atomic<long long> listened_at[2]{-1, -1}, presence_at[2]{-1, -1};
+
+     std::thread server;
+     std::mutex mtx;  //< Guards stopping
+     std::condition_variable cv;
+     bool stopping = false;
+
+     int listener = -1;
+     std::vector<int> conns;
+};
+
+static FakeDiscord fake_discord;
+
+/* === Runner === */
+
+static double cpu_seconds(const rusage& usage) {
+     return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void usage(const char* argv0) {
+     fprintf(stderr,
+             "Usage: %s [OPTIONS] TRACE\n"
+             "       %s [OPTIONS] --synth session|radio|library [--dump]\n"
+             "  TRACE            Trace recorded with AUD_DISCORD_RPC_RECORD\n"
+             "  --synth KIND     Replay a generated trace instead\n"
+             "  --hours H        Length of a generated trace (default: 3)\n"
+             "  --seed N         Seed of a generated trace (default: 1)\n"
+             "  --dump           Print the generated trace and exit\n"
+             "  --set NAME=VAL   Plugin setting (fetch_covers is TRUE)\n"
+             "  --cache FILE     Cover cache file to start with\n"
+             "  --latency MS     Upstream reply time (default: %u)\n"
+             "  --max-gap MS     Max. real wait for cover lookups (default: "
+             "%u)\n"
+             "  --discord-start MS    Start Discord MS after the plugin\n"
+             "  --discord-restart MS  Restart Discord MS after the plugin\n"
+             "  --no-discord     Never start Discord (presences are not sent)\n"
+             "  -v               Log plugin messages (twice: debug too)\n",
+             argv0, argv0, REPLAY_LATENCY, REPLAY_MAX_GAP);
+}
+
+int main(int argc, char** argv) {
+     std::string trace_path, synth, cache_path;
+     double hours = 3;
+     unsigned int seed = 1, max_gap = REPLAY_MAX_GAP;
+     unsigned int discord_start = 0, discord_restart = 0;
+     bool discord = true;
+     bool dump = false;
+     host.config["discord-rpc/fetch_covers"] = "TRUE";
+     for (int i = 1; i < argc; ++i) {
+          const bool has_arg = i + 1 < argc;
+          if (!strcmp(argv[i], "--synth") && has_arg) {
+               synth = argv[++i];
+          } else if (!strcmp(argv[i], "--hours") && has_arg) {
+               hours = std::atof(argv[++i]);
+          } else if (!strcmp(argv[i], "--seed") && has_arg) {
+               seed = std::atoi(argv[++i]);
+          } else if (!strcmp(argv[i], "--dump")) {
+               dump = true;
+          } else if (!strcmp(argv[i], "--set") && has_arg) {
+               std::string setting = argv[++i];
+               auto eq = setting.find('=');
+               if (eq == std::string::npos) {
+                    usage(argv[0]);
+                    return 2;
+               }
+               host.config["discord-rpc/" + setting.substr(0, eq)]
+                   = setting.substr(eq + 1);
+          } else if (!strcmp(argv[i], "--cache") && has_arg) {
+               cache_path = argv[++i];
+          } else if (!strcmp(argv[i], "--latency") && has_arg) {
+               replay_latency = std::atoi(argv[++i]);
+          } else if (!strcmp(argv[i], "--max-gap") && has_arg) {
+               max_gap = std::atoi(argv[++i]);
+          } else if (!strcmp(argv[i], "--discord-start") && has_arg) {
+               discord_start = std::atoi(argv[++i]);
+          } else if (!strcmp(argv[i], "--discord-restart") && has_arg) {
+               discord_restart = std::atoi(argv[++i]);
+          } else if (!strcmp(argv[i], "--no-discord")) {
+               discord = false;
+          } else if (!strcmp(argv[i], "-v")) {
+               host.log_level = std::max(audlog::Debug,
+                                         audlog::Level(host.log_level - 1));
+          } else if (argv[i][0] != '-' && trace_path.empty()) {
+               trace_path = argv[i];
+          } else {
+               usage(argv[0]);
+               return 2;
+          }
+     }
+     if (discord_restart && discord_restart <= discord_start) {
+          usage(argv[0]);
+          return 2;
+     }
+
+     std::vector<Event> events;
+     if (!synth.empty()) {
+          TraceGen gen(seed, hours);
+          if (synth == "session") {
+               events = gen.session();
+          } else if (synth == "radio") {
+               events = gen.radio();
+          } else if (synth == "library") {
+               events = gen.library();
+          } else {
+               usage(argv[0]);
+               return 2;
+          }
+     } else if (trace_path.empty()) {
+          usage(argv[0]);
+          return 2;
+     } else if (!read_trace(trace_path, events)) {
+          fprintf(stderr, "replay: Cannot read %s\n", trace_path.c_str());
+          return 1;
+     }
+     if (dump) {
+          write_trace(stdout, events);
+          return 0;
+     }
+     if (events.empty()) {
+          fprintf(stderr, "replay: Empty trace\n");
+          return 1;
+     }
+
+     // Own user dir (for the cover cache and Discord IPC), no cover daemon
+     char user_dir[] = "/tmp/discord-rpc-replay-XXXXXX";
+     if (!mkdtemp(user_dir)) {
+          perror("replay: mkdtemp");
+          return 1;
+     }
+     host.user_dir = user_dir;
+     if (!cache_path.empty())
+          std::filesystem::copy_file(cache_path,
+                                     host.user_dir + "/" COVER_CACHE_FILE);
+     setenv(COVERD_SOCKET_ENV, (host.user_dir + "/no-coverd").c_str(), 1);
+     setenv("XDG_RUNTIME_DIR", user_dir, 1);
+     unsetenv(RECORD_ENV);
+
+     // Loaded the way Audacious loads plugins (this binary exports it)
+     auto* plugin = static_cast<GeneralPlugin*>(
+         dlsym(RTLD_DEFAULT, "aud_plugin_instance"));
+     if (!plugin) {
+          fprintf(stderr, "replay: No plugin instance: %s\n", dlerror());
+          return 1;
+     }
+
+     using std::chrono::milliseconds;
+     const auto wall_start = clk::now();
+     if (discord)
+          fake_discord.start(wall_start, milliseconds(discord_start),
+                             milliseconds(discord_restart));
+     host.trace_ns.store(events.front().ms * 1000000LL);
+     const auto init_start = clk::now();
+     if (!plugin->init()) {
+          fprintf(stderr, "replay: Plugin init failed\n");
+          return 1;
+     }
+     const double init_ms = std::chrono::duration<double, std::milli>(
+                                clk::now() - init_start)
+                                .count();
+
+     for (std::size_t i = 0; i < events.size(); ++i) {
+          const Event& e = events[i];
+          advance_to(e.ms);
+          host.now = e;
+          host.art = Index<char>(std::vector<char>(e.art.begin(), e.art.end()));
+          if (e.hook == "playback ready") ++host.position;
+
+          const auto threads = stats.threads.load();
+          charged(e.hook, [&] { hook_call(e.hook.c_str(), nullptr); });
+
+          // Let cover lookups started by the hook run for real
+          if (stats.threads.load() != threads) {
+               long long gap = i + 1 < events.size()
+                                   ? events[i + 1].ms - e.ms
+                                   : max_gap;
+               std::this_thread::sleep_for(std::chrono::milliseconds(
+                   std::clamp<long long>(gap, 0, max_gap)));
+          }
+     }
+
+     // Give the plugin the chance to (re)connect, if Discord is late
+     const auto discord_deadline
+         = wall_start
+           + milliseconds(std::max(discord_start, discord_restart)
+                          + REPLAY_DISCORD_WAIT);
+     while (discord && !fake_discord.settled()
+            && clk::now() < discord_deadline)
+          std::this_thread::sleep_for(milliseconds(10));
+
+     plugin->cleanup();
+     fake_discord.stop();
+     const double wall = std::chrono::duration<double>(clk::now() - wall_start)
+                             .count();
+     rusage usage{};
+     getrusage(RUSAGE_SELF, &usage);
+     std::filesystem::remove_all(host.user_dir);
+
+     const double trace_h
+         = std::max(1.0, double(events.back().ms - events.front().ms))
+           / 3600000.0;
+     auto per_h = [trace_h](unsigned long long n) { return n / trace_h; };
+
+     printf("trace:           %zu hooks over %.2f h, replayed in %.1f s\n",
+            events.size(), trace_h, wall);
+     printf("threads:         %llu (%.1f/h)\n", stats.threads.load(),
+            per_h(stats.threads.load()));
+     printf("fetches:         %llu (%.1f/h), %llu B\n", stats.fetches.load(),
+            per_h(stats.fetches.load()), stats.fetch_bytes.load());
+     printf("presence sends:  %llu (%.1f/h), Discord got %llu updates + %llu "
+            "clears\n",
+            stats.presence_sends.load(), per_h(stats.presence_sends.load()),
+            fake_discord.updates.load(), fake_discord.clears.load());
+     printf("cover lookups:   %llu (%llu tag hits, %llu art hits, %llu stale "
+            "hits, %llu revalidated)\n",
+            stats.cover_lookups.load(), stats.cover_tag_hits.load(),
+            stats.cover_art_hits.load(), stats.cover_stale_hits.load(),
+            stats.revalidated.load());
+     printf("CPU time:        %.3f s (%.2f ms/h of trace)\n",
+            cpu_seconds(usage), cpu_seconds(usage) * 1000 / trace_h);
+     printf("max RSS:         %ld KiB\n", usage.ru_maxrss);
+     printf("hook CPU (main thread):\n");
+     for (const auto& [hook, cost] : hook_costs)
+          printf("  %-18s %6llu calls, %8.1f us total, %6.2f us/call, max "
+                 "%6.1f us\n",
+                 hook.c_str(), cost.calls, cost.cpu_ns / 1e3,
+                 cost.cpu_ns / 1e3 / cost.calls, cost.max_ns / 1e3);
+     printf("plugin init:     %.3f ms\n", init_ms);
+     for (int phase = 0; discord && phase < fake_discord.phases(); ++phase) {
+          const auto ttp = fake_discord.time_to_presence(phase);
+          printf("Discord %s at +%lld ms: ", phase ? "restarted" : "started",
+                 static_cast<long long>(fake_discord.up_at(phase).count()));
+          if (ttp)
+               printf("presence after %.1f ms\n", *ttp);
+          else
+               printf("no presence\n");
+     }
+     return 0;
+}
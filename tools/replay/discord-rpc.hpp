@@ -0,0 +1,119 @@
+/**
+ * @file discord-rpc.hpp
+ * @brief Stand-in for the Discord RPC library, for the replay runner
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Same interface as the subset of discord-presence the plugin uses;
+ *       implemented by tools/replay.cpp. Like the real client, it speaks
+ *       Discord's IPC protocol over `discord-ipc-0` (handshake, READY,
+ *       SET_ACTIVITY), here to the runner's stand-in Discord.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace discord {
+
+enum class ActivityType {
+     Game = 0,
+     Streaming = 1,
+     Listening = 2,
+     Watching = 3
+};
+enum class StatusDisplayType { Name = 0, State = 1, Details = 2 };
+
+struct User {
+     std::string id, username;
+};
+
+class Presence {
+   public:
+     Presence& setDetails(std::string_view s) { return set(details, s); }
+     Presence& setState(std::string_view s) { return set(state, s); }
+     Presence& setLargeImageKey(std::string_view s) {
+          return set(large_image_key, s);
+     }
+     Presence& setLargeImageText(std::string_view s) {
+          return set(large_image_text, s);
+     }
+     Presence& setSmallImageKey(std::string_view s) {
+          return set(small_image_key, s);
+     }
+     Presence& setSmallImageText(std::string_view s) {
+          return set(small_image_text, s);
+     }
+     Presence& setStartTimestamp(std::int64_t t) {
+          start_timestamp = t;
+          return *this;
+     }
+     Presence& setEndTimestamp(std::int64_t t) {
+          end_timestamp = t;
+          return *this;
+     }
+     Presence& setActivityType(ActivityType t) {
+          activity_type = t;
+          return *this;
+     }
+     Presence& setStatusDisplayType(StatusDisplayType t) {
+          status_display_type = t;
+          return *this;
+     }
+
+     std::string details, state, large_image_key, large_image_text,
+         small_image_key, small_image_text;
+     std::int64_t start_timestamp = 0, end_timestamp = 0;
+     ActivityType activity_type = ActivityType::Game;
+     StatusDisplayType status_display_type = StatusDisplayType::Name;
+
+   private:
+     Presence& set(std::string& field, std::string_view s) {
+          field = s;
+          return *this;
+     }
+};
+
+class RPCManager {
+   public:
+     static RPCManager& get();
+
+     RPCManager& setClientID(std::string_view id);
+     RPCManager& onReady(std::function<void(const User&)> callback);
+     RPCManager& onDisconnected(
+         std::function<void(int, std::string_view)> callback);
+     RPCManager& onErrored(std::function<void(int, std::string_view)> callback);
+
+     /** @brief Connects and shakes hands; on_ready() comes from the reader */
+     RPCManager& initialize();
+     void shutdown();
+
+     RPCManager& setPresence(const Presence& presence);
+     RPCManager& refresh();
+     RPCManager& clearPresence();
+
+     std::string client_id;
+     std::function<void(const User&)> on_ready;
+     std::function<void(int, std::string_view)> on_disconnected, on_errored;
+     Presence presence;
+
+   private:
+     bool send(unsigned int op, const std::string& json);
+     void read_loop(int fd);
+
+     std::mutex mtx;  //< Guards fd & closing, serialises frames
+     int fd = -1;
+     bool closing = false;
+     std::thread reader;
+};
+
+}  // namespace discord
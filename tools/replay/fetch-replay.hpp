@@ -0,0 +1,74 @@
+/**
+ * @file fetch-replay.hpp
+ * @brief Stand-in HTTP fetcher for the replay runner.
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Selected through RPC_FETCH_HEADER (see fetch-hedge.hpp) in place of
+ *       the cURL one. Requests are answered by stand-in MusicBrainz / Cover
+ *       Art Archive / iTunes (upstream.cpp) after a set latency, so a replay
+ *       never touches the network and costs the same every run.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <cctype>
+#include <functional>
+#include <optional>
+#include <string>
+
+constexpr unsigned long FETCH_TIMEO = 15000;  // [ms]
+constexpr unsigned int REPLAY_LATENCY = 100;  // [ms] per request, by default
+
+#define REPLAY_LATENCY_ENV "DISCORD_RPC_REPLAY_LATENCY"
+
+/* No cURL here; callers' global init is a no-op */
+#define CURL_GLOBAL_DEFAULT 0
+inline int curl_global_init(long) { return 0; }
+inline void curl_global_cleanup() {}
+
+/** @brief Reply of fetch_reply(), with what conditional requests need */
+struct FetchReply {
+     long status = 0;            //< HTTP status (304 = not modified)
+     std::string body;           //< Empty on 304
+     std::string etag;           //< ETag validator, if sent
+     std::string last_modified;  //< Last-Modified validator, if sent
+     std::size_t bytes = 0;      //< Bytes received (headers + body)
+};
+
+/* Reply time of the stand-in upstreams [ms] ($DISCORD_RPC_REPLAY_LATENCY) */
+extern unsigned int replay_latency;
+
+/** @brief Implemented in upstream.cpp; nullopt if cancelled meanwhile */
+std::optional<FetchReply> replay_fetch(const std::string& url,
+                                       const std::string& etag,
+                                       const std::string& last_modified,
+                                       const std::function<bool()>& cancelled);
+
+/* Unused by the runner's own translation unit, which only implements them */
+[[maybe_unused]] static std::optional<FetchReply> fetch_reply(
+    const std::string& url, const std::string& etag = "",
+    const std::string& last_modified = "",
+    const std::function<bool()>& cancelled = nullptr) noexcept {
+     return replay_fetch(url, etag, last_modified, cancelled);
+}
+
+[[maybe_unused]] static std::optional<std::string> uri_encode(
+    const std::string& str) noexcept {
+     static const char HEX[] = "0123456789ABCDEF";
+     std::string enc;
+     for (unsigned char c : str) {
+          if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+               enc += c;
+          } else {
+               enc += '%';
+               enc += HEX[c >> 4];
+               enc += HEX[c & 0xF];
+          }
+     }
+     return enc;
+}
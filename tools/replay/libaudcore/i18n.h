@@ -0,0 +1,3 @@
+/* Stand-in for the replay runner, see ../replay-host.hpp */
+#pragma once
+#include "../replay-host.hpp"
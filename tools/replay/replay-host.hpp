@@ -0,0 +1,296 @@
+/**
+ * @file replay-host.hpp
+ * @brief Stand-in for libaudcore, for replaying hook traces into the plugin
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note The replay runner (tools/replay.cpp) compiles the plugin unchanged
+ *       against the headers in this directory instead of Audacious’ own.
+ *       They only declare what the plugin uses, with the same names and
+ *       signatures; the runner implements them, playing the part of
+ *       Audacious. Every header in libaudcore/ here just includes this file.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* === audstrings.h === */
+
+class String {
+   public:
+     String() = default;
+     explicit String(const char* str) : null(!str), str(str ? str : "") {}
+
+     operator const char*() const { return null ? nullptr : str.c_str(); }
+
+   private:
+     bool null = true;
+     std::string str;
+};
+
+class StringBuf {
+   public:
+     explicit StringBuf(std::string str, const char* interned = nullptr)
+         : str(std::move(str)), interned(interned) {}
+
+     StringBuf&& settle() { return std::move(*this); }
+     operator const char*() const {
+          return interned ? interned : str.c_str();
+     }
+
+   private:
+     std::string str;
+     const char* interned;  //< Outlives the buffer (see int_to_str())
+};
+
+StringBuf str_concat(std::initializer_list<const char*> strings);
+StringBuf str_copy(const char* str, int len = -1);
+StringBuf int_to_str(int val);
+int strcmp_safe(const char* a, const char* b, int len = -1);
+
+/* === index.h === */
+
+template <class T>
+class Index {
+   public:
+     Index() = default;
+     Index(std::vector<T> items) : items(std::move(items)) {}
+
+     T* begin() { return items.data(); }
+     const T* begin() const { return items.data(); }
+     T* end() { return items.data() + items.size(); }
+     const T* end() const { return items.data() + items.size(); }
+     int len() const { return static_cast<int>(items.size()); }
+
+   private:
+     std::vector<T> items;
+};
+
+/* === tuple.h === */
+
+class Tuple {
+   public:
+     enum Field { Title, Artist, Album, AlbumArtist, Basename, Length };
+     enum ValueType { String, Int, Empty };
+
+     ValueType get_value_type(Field field) const;
+     int get_int(Field field) const;
+     ::String get_str(Field field) const;
+
+     void set_str(Field field, const char* str);
+     void set_int(Field field, int val);
+
+   private:
+     static constexpr int N_FIELDS = Length + 1;
+     ::String strs[N_FIELDS];
+     int ints[N_FIELDS] = {};
+     ValueType types[N_FIELDS] = {Empty, Empty, Empty, Empty, Empty, Empty};
+};
+
+/* === drct.h === */
+
+bool aud_drct_get_playing();
+bool aud_drct_get_ready();
+bool aud_drct_get_paused();
+int aud_drct_get_time();
+String aud_drct_get_filename();
+Tuple aud_drct_get_tuple();
+
+/* === hook.h === */
+
+typedef void (*HookFunction)(void* data, void* user);
+
+void hook_associate(const char* name, HookFunction func, void* user);
+void hook_dissociate(const char* name, HookFunction func,
+                     void* user = nullptr);
+void hook_call(const char* name, void* data);
+
+/* === i18n.h === */
+
+#define _(str) (str)
+#define N_(str) (str)
+
+/* === runtime.h === */
+
+namespace audlog {
+enum Level { Debug, Info, Warning, Error };
+void log(Level level, const char* file, int line, const char* func,
+         const char* format, ...) __attribute__((format(printf, 5, 6)));
+}  // namespace audlog
+
+#define AUDDBG(...) \
+     audlog::log(audlog::Debug, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define AUDINFO(...) \
+     audlog::log(audlog::Info, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define AUDWARN(...)                                                   \
+     audlog::log(audlog::Warning, __FILE__, __LINE__, __FUNCTION__, \
+                 __VA_ARGS__)
+#define AUDERR(...) \
+     audlog::log(audlog::Error, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+
+enum class AudPath { UserDir };
+const char* aud_get_path(AudPath id);
+
+void aud_config_set_defaults(const char* section, const char* const* entries);
+bool aud_get_bool(const char* section, const char* name);
+int aud_get_int(const char* section, const char* name);
+String aud_get_str(const char* section, const char* name);
+
+/* === mainloop.h === */
+
+namespace replay {
+/** @brief Trace time: advanced by the runner, not by the wall clock */
+struct clock {
+     using duration = std::chrono::nanoseconds;
+     using rep = duration::rep;
+     using period = duration::period;
+     using time_point = std::chrono::time_point<clock>;
+     static constexpr bool is_steady = true;
+
+     static time_point now() noexcept;
+};
+}  // namespace replay
+
+/* Runs on trace time, from the runner’s (main) thread */
+class QueuedFunc {
+   public:
+     typedef void (*Func)(void* data);
+
+     QueuedFunc() = default;
+     QueuedFunc(const QueuedFunc&) = delete;
+     QueuedFunc& operator=(const QueuedFunc&) = delete;
+     ~QueuedFunc() { stop(); }
+
+     void queue(Func func, void* data) { queue(0, func, data); }
+     void queue(int delay_ms, Func func, void* data);
+     void stop();
+     bool running() const;
+};
+
+/* === playlist.h === */
+
+class Playlist {
+   public:
+     static Playlist playing_playlist();
+     int get_position() const;
+     bool operator==(const Playlist& other) const = default;
+
+   private:
+     int id = -1;
+};
+
+/* === preferences.h === */
+
+template <class T>
+struct ArrayRef {
+     template <std::size_t N>
+     constexpr ArrayRef(const T (&array)[N]) : data(array), len(N) {}
+     constexpr ArrayRef(std::nullptr_t) : data(nullptr), len(0) {}
+
+     const T* data;
+     std::size_t len;
+};
+
+struct ComboItem {
+     constexpr ComboItem(const char* label, int num) : label(label), num(num) {}
+     const char* label;
+     int num;
+};
+
+struct WidgetBool {
+     constexpr WidgetBool(const char* section, const char* name,
+                          void (*callback)() = nullptr)
+         : section(section), name(name), callback(callback) {}
+     const char *section, *name;
+     void (*callback)();
+};
+
+struct WidgetInt {
+     constexpr WidgetInt(const char* section, const char* name,
+                         void (*callback)() = nullptr)
+         : section(section), name(name), callback(callback) {}
+     const char *section, *name;
+     void (*callback)();
+};
+
+struct WidgetVCombo {
+     ArrayRef<ComboItem> elems;
+     ArrayRef<ComboItem> (*fill)();
+};
+
+struct WidgetVButton {
+     void (*callback)();
+     const char* icon;
+};
+
+struct PreferencesWidget {
+     const char* label;
+};
+
+inline PreferencesWidget WidgetCheck(const char* label, WidgetBool) {
+     return {label};
+}
+inline PreferencesWidget WidgetCombo(const char* label, WidgetInt,
+                                     WidgetVCombo) {
+     return {label};
+}
+inline PreferencesWidget WidgetButton(const char* label, WidgetVButton) {
+     return {label};
+}
+
+struct PluginPreferences {
+     ArrayRef<PreferencesWidget> widgets;
+     void (*init)();
+     void (*apply)();
+     void (*cleanup)();
+};
+
+/* === plugin.h === */
+
+struct PluginInfo {
+     const char* name;
+     const char* domain;
+     const char* about;
+     const PluginPreferences* prefs;
+     int flags;
+};
+
+class GeneralPlugin {
+   public:
+     constexpr GeneralPlugin(const PluginInfo& info, bool enabled_by_default)
+         : info(info), enabled_by_default(enabled_by_default) {}
+
+     virtual bool init() { return true; }
+     virtual void cleanup() {}
+
+     const PluginInfo info;
+     const bool enabled_by_default;
+};
+
+/* === probe.h === */
+
+enum { AUD_ART_DATA = 1, AUD_ART_FILE = 2 };
+
+class AudArtPtr {
+   public:
+     AudArtPtr(const Index<char>* art = nullptr) : art(art) {}
+
+     const Index<char>* data() const { return art; }
+     explicit operator bool() const { return art; }
+
+   private:
+     const Index<char>* art;
+};
+
+AudArtPtr aud_art_request(const char* file, int format,
+                          bool* queued = nullptr);
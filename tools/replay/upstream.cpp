@@ -0,0 +1,138 @@
+/**
+ * @file upstream.cpp
+ * @brief Stand-in cover art upstreams (MusicBrainz, Cover Art Archive, iTunes)
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Implements replay_fetch() of fetch-replay.hpp for the replay runner
+ *       and the cover daemon benchmark. Replies are shaped like the real
+ *       ones and derived from the URL alone, so runs are repeatable: every
+ *       search finds 25 releases (bar ~5 % of queries, which find none),
+ *       every release has a front cover, iTunes never finds anything.
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "fetch-replay.hpp"
+
+unsigned int replay_latency = [] {
+     const char* latency = getenv(REPLAY_LATENCY_ENV);
+     return latency ? static_cast<unsigned int>(std::atoi(latency))
+                    : REPLAY_LATENCY;
+}();
+
+static std::uint64_t fnv1a(const std::string& s) {
+     std::uint64_t hash = 0xcbf29ce484222325ULL;
+     for (unsigned char c : s) hash = (hash ^ c) * 0x100000001b3ULL;
+     return hash;
+}
+
+static std::string fake_mbid(std::uint64_t hash) {
+     char mbid[37];
+     snprintf(mbid, sizeof(mbid), "%08x-%04x-4%03x-8%03x-%012llx",
+              static_cast<unsigned>(hash >> 32),
+              static_cast<unsigned>(hash >> 16) & 0xFFFF,
+              static_cast<unsigned>(hash >> 4) & 0xFFF,
+              static_cast<unsigned>(hash >> 20) & 0xFFF,
+              static_cast<unsigned long long>(hash) & 0xFFFFFFFFFFFFULL);
+     return mbid;
+}
+
+/* Sized like the real replies (25 search results; a CAA listing with
+ * a few images), so parsing and byte counts are realistic */
+static std::string musicbrainz_reply(const std::string& url) {
+     const std::uint64_t hash = fnv1a(url);
+     if (hash % 20 == 0) return R"({"created":"2026-10-18T12:00:00.000Z",)"
+                                R"("count":0,"offset":0,"releases":[]})";
+     std::string body = R"({"created":"2026-10-18T12:00:00.000Z",)"
+                        R"("count":25,"offset":0,"releases":[)";
+     for (int i = 0; i < 25; ++i) {
+          if (i) body += ',';
+          body += R"({"id":")" + fake_mbid(hash + i) + R"(","score":)"
+                  + std::to_string(100 - i * 3)
+                  + R"(,"status-id":"4e304316-386d-3409-af2e-78857eec5cfe",)"
+                    R"("count":1,"title":"Album","status":"Official",)"
+                    R"("text-representation":{"language":"eng",)"
+                    R"("script":"Latn"},"artist-credit":[{"name":"Artist",)"
+                    R"("artist":{"id":")"
+                  + fake_mbid(hash ^ i)
+                  + R"(","name":"Artist","sort-name":"Artist"}}],)"
+                    R"("release-group":{"id":")"
+                  + fake_mbid(~hash + i)
+                  + R"(","primary-type":"Album","title":"Album"},)"
+                    R"("date":"2020-01-01","country":"XW",)"
+                    R"("label-info":[{"label":{"name":"Label"}}],)"
+                    R"("track-count":12,"media":[{"format":"Digital Media",)"
+                    R"("disc-count":0,"track-count":12}]})";
+     }
+     return body + "]}";
+}
+
+static std::string caa_reply(const std::string& mbid) {
+     const std::string base = "https://coverartarchive.org/release/" + mbid;
+     const std::string image
+         = std::to_string(10000000000ULL + fnv1a(mbid) % 1000000);
+     std::string body = R"({"images":[)";
+     for (int i = 0; i < 3; ++i) {
+          const std::string id = image + std::to_string(i);
+          if (i) body += ',';
+          body += R"({"approved":true,"back":)"
+                  + std::string(i ? "true" : "false")
+                  + R"(,"comment":"","edit":12345678,"front":)"
+                  + std::string(i ? "false" : "true") + R"(,"id":)" + id
+                  + R"(,"image":")" + base + "/" + id
+                  + R"(.jpg","thumbnails":{"1200":")" + base + "/" + id
+                  + R"(-1200.jpg","250":")" + base + "/" + id
+                  + R"(-250.jpg","500":")" + base + "/" + id
+                  + R"(-500.jpg","large":")" + base + "/" + id
+                  + R"(-500.jpg","small":")" + base + "/" + id
+                  + R"(-250.jpg"},"types":[")" + (i ? "Back" : "Front")
+                  + R"("]})";
+     }
+     return body + R"(],"release":")" + base + R"("})";
+}
+
+std::optional<FetchReply> replay_fetch(const std::string& url,
+                                       const std::string& etag,
+                                       const std::string&,
+                                       const std::function<bool()>& cancelled) {
+     const auto until = std::chrono::steady_clock::now()
+                        + std::chrono::milliseconds(replay_latency);
+     while (std::chrono::steady_clock::now() < until) {
+          if (cancelled && cancelled()) return std::nullopt;
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+     }
+
+     FetchReply reply;
+     reply.status = 200;
+     constexpr std::string_view CAA = "https://coverartarchive.org/release/";
+     if (url.starts_with("https://musicbrainz.org/ws/2/release")) {
+          reply.body = musicbrainz_reply(url);
+     } else if (url.starts_with(CAA)) {
+          const std::string mbid = url.substr(CAA.size());
+          char tag[16];
+          snprintf(tag, sizeof(tag), "\"%llu\"",
+                   static_cast<unsigned long long>(fnv1a(mbid) % 1000000));
+          reply.etag = tag;
+          if (etag == reply.etag)
+               reply.status = 304;  // Covers never change here
+          else
+               reply.body = caa_reply(mbid);
+     } else if (url.starts_with("https://itunes.apple.com/search")) {
+          reply.body = R"({"resultCount":0,"results":[]})";
+     } else {
+          reply.status = 404;
+     }
+     reply.bytes = 350 + reply.body.size();  // Headers + body
+     return reply;
+}
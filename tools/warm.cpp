@@ -0,0 +1,294 @@
+/**
+ * @file warm.cpp
+ * @brief Offline cover cache warmer for Audacious Discord RPC
+ * @version 2.2
+ * @author onegen <onegen@onegen.dev>
+ * @date 2026-10-18 (last modified)
+ *
+ * @note Resolves covers of a whole library ahead of time, so the first play
+ *       of an album does not have to wait for MusicBrainz. Input is a TSV
+ *       file of `<album artist>` TAB `<album>` lines and/or exported
+ *       Audacious playlists (`.audpl`). Albums are de-duplicated and looked
+ *       up in parallel, within the upstream rate limit, using the same
+ *       providers as the plugin; results go straight into the persistent
+ *       cache file the plugin loads. Both merge their covers into the file
+ *       on saving, so Audacious may keep running meanwhile. An interrupted
+ *       run (Ctrl+C) can be resumed by running the same command again.
+ *
+ * @code{.sh}
+ * discord-rpc-warm [-j N] [--interval MS] [--itunes] [-o FILE] INPUT...
+ * @endcode
+ *
+ * @license MIT
+ * @copyright Copyright (c) 2026 onegen
+ *
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define AUDERR(...) fprintf(stderr, __VA_ARGS__)
+
+#include "covers.hpp"
+
+#define COVER_CACHE_FILE "discord-rpc-covers.tsv"  // In Audacious user dir
+
+constexpr unsigned int WARM_REPORT_INTERVAL = 2000;  // [ms]
+constexpr unsigned int WARM_SAVE_EVERY = 25;         // Resolved covers
+
+using Album = std::pair<std::string, std::string>;  // Album artist, album
+
+/* Bumped on SIGINT, which cancels all running lookups */
+static std::atomic<unsigned long long> run_id{0};
+
+/* === Input === */
+
+/** @brief Mirrors field_sanitise() of the plugin, so cache keys match */
+static std::string sanitise(const std::string& field) {
+     if (field.empty()) return "[unknown]";
+     if (field.size() < 2) return field + " ";
+     if (field.size() <= 128) return field;
+     return field.substr(0, 124) + "...";
+}
+
+/** @brief Album key as the plugin builds it from a tuple */
+static Album album_of(const std::string& artist,
+                      const std::string& album_artist,
+                      const std::string& album) {
+     return {album_artist.empty() ? sanitise(artist) : album_artist,
+             sanitise(album)};
+}
+
+/** @brief Decodes %XX escapes (Audacious playlist values) */
+static std::string percent_decode(const std::string& s) {
+     std::string r;
+     r.reserve(s.size());
+     for (std::size_t i = 0; i < s.size(); ++i) {
+          unsigned int byte;
+          if (s[i] == '%' && i + 2 < s.size()
+              && sscanf(s.c_str() + i + 1, "%2x", &byte) == 1) {
+               r += static_cast<char>(byte);
+               i += 2;
+          } else {
+               r += s[i];
+          }
+     }
+     return r;
+}
+
+static void read_audpl(std::ifstream& in, std::vector<Album>& albums) {
+     std::string line, artist, album_artist, album;
+     auto flush = [&] {
+          if (!album.empty())
+               albums.push_back(album_of(artist, album_artist, album));
+          artist.clear(), album_artist.clear(), album.clear();
+     };
+
+     while (std::getline(in, line)) {
+          auto eq = line.find('=');
+          if (eq == std::string::npos) continue;
+          std::string field = line.substr(0, eq);
+          if (field == "uri")
+               flush();  // Every entry starts with its URI
+          else if (field == "artist")
+               artist = percent_decode(line.substr(eq + 1));
+          else if (field == "album-artist")
+               album_artist = percent_decode(line.substr(eq + 1));
+          else if (field == "album")
+               album = percent_decode(line.substr(eq + 1));
+     }
+     flush();
+}
+
+static void read_tsv(std::ifstream& in, std::vector<Album>& albums) {
+     std::string line;
+     while (std::getline(in, line)) {
+          if (!line.empty() && line.back() == '\r') line.pop_back();
+          if (line.empty() || line[0] == '#') continue;
+          auto tab = line.find('\t');
+          if (tab == std::string::npos || tab + 1 == line.size()) continue;
+          albums.push_back(
+              album_of("", line.substr(0, tab), line.substr(tab + 1)));
+     }
+}
+
+static bool read_input(const std::string& path, std::vector<Album>& albums) {
+     std::ifstream in(path);
+     if (!in) return false;
+     if (path.ends_with(".audpl"))
+          read_audpl(in, albums);
+     else
+          read_tsv(in, albums);
+     return true;
+}
+
+/* === Main === */
+
+static std::string default_cache_path() {
+     // Audacious user dir: $XDG_CONFIG_HOME/audacious or ~/.config/audacious
+     const char* xdg = getenv("XDG_CONFIG_HOME");
+     const char* home = getenv("HOME");
+     std::string dir = (xdg && *xdg) ? std::string(xdg)
+                                     : std::string(home ? home : ".")
+                                           + "/.config";
+     return dir + "/audacious/" COVER_CACHE_FILE;
+}
+
+static void usage(const char* argv0) {
+     fprintf(stderr,
+             "Usage: %s [-j N] [--interval MS] [--itunes] [-o FILE] "
+             "INPUT...\n"
+             "  INPUT          TSV of album artist <TAB> album, or an "
+             "exported .audpl playlist\n"
+             "  -j N           Parallel lookups (default: 4)\n"
+             "  --interval MS  Min. time between requests to one upstream "
+             "host (default: 1000)\n"
+             "  --itunes       Also race the iTunes provider\n"
+             "  -o FILE        Cache file (default: %s)\n",
+             argv0, default_cache_path().c_str());
+}
+
+int main(int argc, char** argv) {
+     std::string cache_path = default_cache_path();
+     std::vector<std::string> inputs;
+     unsigned int n_jobs = 4;
+     long interval_ms = 1000;  // MusicBrainz allows 1 req/s per IP
+     for (int i = 1; i < argc; ++i) {
+          if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+               n_jobs = std::max(1L, strtol(argv[++i], nullptr, 10));
+          } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+               interval_ms = strtol(argv[++i], nullptr, 10);
+          } else if (!strcmp(argv[i], "--itunes")) {
+               itunes_provider.enabled.store(true);
+          } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+               cache_path = argv[++i];
+          } else if (argv[i][0] != '-') {
+               inputs.push_back(argv[i]);
+          } else {
+               usage(argv[0]);
+               return 2;
+          }
+     }
+     if (inputs.empty()) {
+          usage(argv[0]);
+          return 2;
+     }
+
+     // Read + de-duplicate
+     std::vector<Album> albums;
+     for (auto& input : inputs)
+          if (!read_input(input, albums))
+               fprintf(stderr, "warm: Cannot read %s, skipping\n",
+                       input.c_str());
+     std::set<Album> seen;
+     std::erase_if(albums,
+                   [&seen](const Album& a) { return !seen.insert(a).second; });
+
+     /* Resuming: covers already in the cache file are skipped (by its
+      * keys, as the cache itself may not hold them all), and so are albums
+      * tried (but not found) by an interrupted run, which are kept in a
+      * progress file next to the cache until a run completes. Expired
+      * covers are looked up again. */
+     std::set<std::string> cached;
+     cache.load(cache_path, &cached);
+     const std::string progress_path = cache_path + ".progress";
+     std::set<std::string> tried;
+     {
+          std::ifstream in(progress_path);
+          std::string line;
+          while (std::getline(in, line)) tried.insert(line);
+     }
+     std::erase_if(albums, [&cached, &tried](const Album& a) {
+          return cached.contains(CoverArtCache::key(a.first, a.second))
+                 || tried.contains(a.first + '\t' + a.second);
+     });
+
+     fprintf(stderr,
+             "warm: %zu albums to look up (%zu cached covers, %zu tried "
+             "before)\n",
+             albums.size(), cached.size(), tried.size());
+     if (albums.size() > 8192)
+          fprintf(stderr,
+                  "warm: Note that the cache holds at most 8192 covers\n");
+
+     RateLimiter limiter{std::chrono::milliseconds(interval_ms)};
+     fetch_limiter = &limiter;
+     curl_global_init(CURL_GLOBAL_DEFAULT);
+     signal(SIGINT, [](int) { run_id.store(1); });
+     signal(SIGTERM, [](int) { run_id.store(1); });
+
+     std::ofstream progress(progress_path, std::ios::app);
+     std::mutex progress_mtx;  //< Guards progress & unsaved
+     unsigned int unsaved = 0;
+     std::atomic<std::size_t> next{0}, n_done{0}, n_found{0};
+
+     auto worker = [&] {
+          for (std::size_t i; (i = next++) < albums.size();) {
+               if (run_id.load()) return;
+               auto& [artist, album] = albums[i];
+               // Expired covers (kept stale) only need revalidating
+               auto res = cover_revalidate(artist, album,
+                                           [] { return run_id.load() != 0; });
+               if (!res) res = cover_race(artist, album, &run_id, 0);
+               if (run_id.load()) return;  // Cancelled, not tried
+
+               ++n_done;
+               std::lock_guard<std::mutex> lock(progress_mtx);
+               if (res) {
+                    ++n_found;
+                    cache.put(artist, album, res->url, res->validators);
+                    if (++unsaved >= WARM_SAVE_EVERY) {
+                         cache.save(cache_path, true);
+                         unsaved = 0;
+                    }
+               }
+               progress << artist << '\t' << album << '\n' << std::flush;
+          }
+     };
+
+     const auto start = std::chrono::steady_clock::now();
+     std::vector<std::thread> workers;
+     for (unsigned int j = 0; j < n_jobs; ++j) workers.emplace_back(worker);
+
+     auto report = [&] {
+          double secs = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+          double per_min = secs > 0 ? n_done.load() * 60.0 / secs : 0;
+          fprintf(stderr,
+                  "warm: %zu/%zu done, %zu found, %.1f albums/min, "
+                  "ETA %.0f min\n",
+                  n_done.load(), albums.size(), n_found.load(), per_min,
+                  per_min > 0 ? (albums.size() - n_done.load()) / per_min
+                              : 0.0);
+     };
+     while (n_done.load() < albums.size() && !run_id.load()) {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(WARM_REPORT_INTERVAL));
+          if (n_done.load() < albums.size()) report();
+     }
+     for (auto& w : workers) w.join();
+
+     if (!cache.save(cache_path, true)) {
+          fprintf(stderr, "warm: Cannot save cache to %s\n",
+                  cache_path.c_str());
+          return 1;
+     }
+     if (run_id.load()) {
+          fprintf(stderr, "warm: Interrupted, run again to resume\n");
+          return 130;
+     }
+
+     progress.close();
+     std::remove(progress_path.c_str());
+     report();
+     return 0;
+}